@@ -39,8 +39,15 @@
 #define __cgixx_cgi_h
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
+#include <memory_resource>
 #include <stdexcept>
+#include <cstddef>
+#include <type_traits>
+#include <cgixx/upload.h>
+#include <cgixx/json.h>
 
 namespace cgixx {
 
@@ -94,6 +101,217 @@ enum headers {
 	header_http_cookie
 };
 
+/**
+ * Map a character of an HTTP header name to its character in the CGI
+ * environment variable name: letters are upper case and - becomes _.
+ */
+constexpr char httpenvchar(char c)
+{
+	return c == '-' ? '_' : (c >= 'a' && c <= 'z') ? char(c - 'a' + 'A') : c;
+}
+
+/**
+ * Check whether an HTTP header name, in any case, is Content-Type or
+ * Content-Length, which CGI passes as CONTENT_TYPE and CONTENT_LENGTH
+ * instead of with an HTTP_ prefix.
+ */
+constexpr bool iscontentheader(std::string_view name)
+{
+	const std::string_view type("CONTENT_TYPE"), length("CONTENT_LENGTH");
+	std::string_view env(name.length() == type.length() ? type : length);
+	if (name.length() != env.length())
+		return false;
+	for (std::size_t i = 0; i != name.length(); ++i)
+		if (httpenvchar(name[i]) != env[i])
+			return false;
+	return true;
+}
+
+/**
+ * The httpheader class holds the CGI environment variable name of an
+ * HTTP request header, such as HTTP_ACCEPT_ENCODING for Accept-Encoding.
+ * Content-Type and Content-Length map to CONTENT_TYPE and
+ * CONTENT_LENGTH.  Declare it constexpr to compute the name at compile
+ * time:
+ *
+ *	constexpr cgixx::httpheader acceptencoding("Accept-Encoding");
+ */
+template <std::size_t N>
+class httpheader {
+public:
+	/// Convert the header name literal.
+	constexpr httpheader(const char (&name)[N]) : buf(), len(0)
+	{
+		if (!iscontentheader(std::string_view(name, N - 1)))
+		{
+			buf[0] = 'H'; buf[1] = 'T'; buf[2] = 'T'; buf[3] = 'P'; buf[4] = '_';
+			len = 5;
+		}
+		for (std::size_t i = 0; i + 1 < N; ++i)
+			buf[len++] = httpenvchar(name[i]);
+	}
+
+	/// Get the environment variable name.
+	constexpr std::string_view envname() const
+	{ return std::string_view(buf, len); }
+
+private:
+	char buf[N + 4];
+	std::size_t len;
+};
+
+/**
+ * The cgilimits structure bounds what a request may send.  Limits are
+ * checked while the request is read and parsed, so an oversized request
+ * is rejected with a cgiexception before it is stored.  A limit of 0
+ * means no limit, which is the default.
+ */
+struct cgilimits {
+	cgilimits() : maxbody(0), maxparams(0), maxname(0), maxvalue(0),
+		maxcookies(0) {}
+
+	/// Largest request body, in bytes.
+	unsigned long maxbody;
+
+	/// Most variables, counting uploaded files.
+	std::size_t maxparams;
+
+	/**
+	 * Longest variable or cookie name, in bytes as sent.  An ISINDEX
+	 * query is read as a name.
+	 */
+	std::size_t maxname;
+
+	/**
+	 * Longest variable or cookie value, in bytes as sent.  Uploaded
+	 * files are bounded only by maxbody.
+	 */
+	std::size_t maxvalue;
+
+	/// Most cookies.
+	std::size_t maxcookies;
+};
+
+/**
+ * The cgioptions structure controls how a cgi instance processes a
+ * request.  The defaults match the behavior of the default constructor.
+ */
+struct cgioptions {
+	cgioptions() : lazydecode(false), deferparse(false),
+		spillthreshold(65536), resource(0) {}
+
+	/**
+	 * Percent-decode each value only when it is first retrieved, so
+	 * unused values cost nothing beyond tokenizing.  Retrieval then
+	 * modifies the cgi instance, even through const methods, so such an
+	 * instance must not be shared between threads.
+	 */
+	bool lazydecode;
+
+	/**
+	 * Parse the query string or body, and the cookies, only when they
+	 * are first used, so requests that are rejected early do not read
+	 * the body at all.  Any method that reads variables or uploads may
+	 * then throw cgiexception for a bad body, and will throw it again on
+	 * every later call.  Call cgi::parse to choose where that happens.
+	 * Until then, the first use parses and modifies the cgi instance,
+	 * even through const methods, so a deferred instance must not be
+	 * shared between threads unless cgi::parse has been called.
+	 */
+	bool deferparse;
+
+	/**
+	 * Size in bytes beyond which an uploaded file is moved from memory
+	 * to an unlinked temporary file.  Files always stay in memory on
+	 * Win32.
+	 */
+	std::size_t spillthreshold;
+
+	/**
+	 * Directory for temporary upload files.  If empty, TMPDIR is used,
+	 * or /tmp.
+	 */
+	std::string tempdir;
+
+	/// Limits on the size of the request.
+	cgilimits limits;
+
+	/**
+	 * Memory resource from which the cgi instance and everything it
+	 * stores are allocated, or 0 for std::pmr::get_default_resource().
+	 * It must outlive the cgi instance.  A per-request
+	 * std::pmr::monotonic_buffer_resource lets a persistent server free
+	 * all memory of a request at once and avoids contending on the heap.
+	 */
+	std::pmr::memory_resource* resource;
+};
+
+/**
+ * The geterrors enumeration lists the ways a typed cgi::get can fail.
+ */
+enum geterrors {
+	get_ok = 0,
+	get_missing,	///< the value was not sent, or was sent empty
+	get_invalid,	///< the value is not a number or boolean of the type
+	get_range	///< the value does not fit in the type
+};
+
+/**
+ * The getresult structure holds the value converted by a typed cgi::get,
+ * or the default value if the conversion failed, and why it failed.
+ */
+template <typename T>
+struct getresult {
+	/// The converted value, or the default on failure.
+	T value;
+
+	/// get_ok, or the reason the conversion failed.
+	geterrors error;
+
+	/// Check if the conversion failed.
+	bool failed() const { return error != get_ok; }
+};
+
+/**
+ * The isconvertible trait is true for exactly the types a typed cgi::get
+ * can convert to, those with a convertvalue overload.
+ */
+template <typename T>
+struct isconvertible : std::integral_constant<bool,
+	std::is_same<T, bool>::value ||
+	std::is_same<T, short>::value ||
+	std::is_same<T, unsigned short>::value ||
+	std::is_same<T, int>::value ||
+	std::is_same<T, unsigned>::value ||
+	std::is_same<T, long>::value ||
+	std::is_same<T, unsigned long>::value ||
+	std::is_same<T, long long>::value ||
+	std::is_same<T, unsigned long long>::value ||
+	std::is_same<T, float>::value ||
+	std::is_same<T, double>::value ||
+	std::is_same<T, long double>::value> {};
+
+/**
+ * Convert a whole value to an integer, floating point or bool type with
+ * std::from_chars, as a typed cgi::get does.
+ *
+ * @param	raw	The text of the value.
+ * @param	value	Reference to receive the value, unchanged on failure.
+ * @return	get_ok, get_invalid or get_range.
+ */
+geterrors convertvalue(std::string_view raw, bool& value);
+geterrors convertvalue(std::string_view raw, short& value);
+geterrors convertvalue(std::string_view raw, unsigned short& value);
+geterrors convertvalue(std::string_view raw, int& value);
+geterrors convertvalue(std::string_view raw, unsigned& value);
+geterrors convertvalue(std::string_view raw, long& value);
+geterrors convertvalue(std::string_view raw, unsigned long& value);
+geterrors convertvalue(std::string_view raw, long long& value);
+geterrors convertvalue(std::string_view raw, unsigned long long& value);
+geterrors convertvalue(std::string_view raw, float& value);
+geterrors convertvalue(std::string_view raw, double& value);
+geterrors convertvalue(std::string_view raw, long double& value);
+
 /// Forward declaration, for intenal use
 struct cgi_impl;
 
@@ -109,41 +327,160 @@ struct cgi_impl;
  */
 class cgi {
 public:
+	typedef std::vector< std::string > identifierlist;
+	typedef std::map< std::string, std::string > environment;
+
+	/**
+	 * All values of one variable, in the order they were sent.  The
+	 * views remain valid for the lifetime of the cgi instance.
+	 */
+	class valuerange {
+	public:
+		typedef const std::string_view* iterator;
+
+		valuerange() : first(0), last(0) {}
+		valuerange(iterator b, iterator e) : first(b), last(e) {}
+
+		iterator begin() const { return first; }
+		iterator end() const { return last; }
+		std::size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+		const std::string_view& operator[](std::size_t i) const
+		{ return first[i]; }
+
+	private:
+		iterator first;
+		iterator last;
+	};
+
 	cgi();
+	explicit cgi(const cgioptions& opts);
+	cgi(const environment& env, const std::string& input,
+		const cgioptions& opts = cgioptions());
+	cgi(cgi&& other) noexcept;
 	~cgi();
 
-	typedef std::vector< std::string > identifierlist;
+	cgi& operator=(cgi&& other) noexcept;
 
 	/// Get the cgixx library version string.
 	const std::string& libver();
 
+	/// Parse deferred input now.
+	void parse();
+
 	/// Get count of a variable.
-	unsigned count(const std::string& id) const;
+	unsigned count(std::string_view id) const;
 
 	/// Check if a variable exists.
-	bool exists(const std::string& id);
+	bool exists(std::string_view id);
 
 	/// Get next available value of a variable.
-	bool get(const std::string& id, std::string& value);
+	bool get(std::string_view id, std::string& value);
+
+	/**
+	 * Get a value of a variable converted to an integer, floating point
+	 * or bool type, without retrieving it.  The value is parsed in place
+	 * with std::from_chars, independent of the locale, and must be
+	 * entirely a number in decimal, optionally signed.  A bool accepts
+	 * 1, true, on and yes, or 0, false, off and no, in any case.
+	 *
+	 *	int page = cgi.get("page", 1).value;
+	 *	cgixx::getresult<double> price = cgi.get<double>("price");
+	 *
+	 * @param	id	Identifier of CGI variable.
+	 * @param	def	Value to return if the conversion fails.
+	 * @param	index	Position of the value, counting from 0.
+	 * @return	The converted value or def, and get_ok or the reason
+	 *		for failure.  No exception is thrown for a bad value.
+	 */
+	template <typename T>
+	getresult<T> get(std::string_view id, T def = T(), unsigned index = 0) const
+	{
+		static_assert(isconvertible<T>::value,
+			"cgi::get converts only to bool, short, int, long, long long, "
+			"their unsigned types, float, double or long double");
+		getresult<T> result;
+		std::string_view raw;
+		result.value = def;
+		if (getvalue(id, index, raw) || raw.empty())
+			result.error = get_missing;
+		else if ((result.error = convertvalue(raw, result.value)) != get_ok)
+			result.value = def;
+		return result;
+	}
+
+	/// Get count of all values of a variable, retrieved or not.
+	unsigned countvalues(std::string_view id) const;
+
+	/// Get a value of a variable by index, without retrieving it.
+	bool getvalue(std::string_view id, unsigned index,
+		std::string_view& value) const;
+
+	/// Get all values of a variable, without retrieving them.
+	valuerange getvalues(std::string_view id) const;
 
 	/// Get list of variable identifiers.
 	void getvariablelist(identifierlist& idlist) const;
 
+	/// Get count of distinct variable identifiers.
+	unsigned countvariables() const;
+
+	/// Get a variable identifier by position.
+	bool getvariable(unsigned n, std::string_view& id) const;
+
+	/// Get a variable identifier and all its values by position.
+	bool getvariable(unsigned n, std::string_view& id,
+		valuerange& values) const;
+
+	/// Get one value of a variable by position.
+	bool getvariablevalue(unsigned n, unsigned index,
+		std::string_view& value) const;
+
 	/// Get count of a cookie.
-	unsigned countcookie(const std::string& id) const;
+	unsigned countcookie(std::string_view id) const;
 
 	/// Check if a cookie exists.
-	bool cookieexists(const std::string& id);
+	bool cookieexists(std::string_view id);
 
 	/// Get next available value of a cookie.
-	bool getcookie(const std::string& id, std::string& value);
+	bool getcookie(std::string_view id, std::string& value);
+
+	/// Get a view of the first value of a cookie, without retrieving it.
+	bool findcookie(std::string_view id, std::string_view& value) const;
 
 	/// Get list of cookie identifiers.
 	void getcookielist(identifierlist& idlist) const;
 
+	/// Get count of files uploaded by a form field.
+	unsigned countupload(std::string_view id) const;
+
+	/// Get a file uploaded by a form field.
+	const upload* getupload(std::string_view id, unsigned index = 0) const;
+
+	/// Get list of form fields with uploaded files.
+	void getuploadlist(identifierlist& idlist) const;
+
+	/// Get a value of an application/json body by JSON pointer.
+	jsonvalue getjson(std::string_view pointer = std::string_view()) const;
+
 	/// Get the specified header.
 	bool getheader(headers hid, std::string& copy) const;
 
+	/// Get a view of the specified header.
+	bool getheader(headers hid, std::string_view& value) const;
+
+	/// Get a view of a CGI meta-variable or HTTP_* variable by name.
+	bool getmetavar(std::string_view name, std::string_view& value) const;
+
+	/// Get a view of a request header by its HTTP name.
+	bool getrequestheader(std::string_view name, std::string_view& value) const;
+
+	/// Get a view of a request header named at compile time.
+	template <std::size_t N>
+	bool getrequestheader(const httpheader<N>& name,
+		std::string_view& value) const
+	{ return getmetavar(name.envname(), value); }
+
 	/// Get the request method.
 	methods getmethod() const;
 
@@ -153,11 +490,13 @@ private:
 	// There is not copy operator.
 	cgi& operator=(const cgi&);
 
+
 	cgi_impl* imp;
 };
 
 // Other useful functions
 std::string& makesafestring(const std::string& instr, std::string& outstr);
+std::string& appendsafestring(std::string_view instr, std::string& outstr);
 
 } // end namespace cgixx
 
@@ -40,3 +40,8 @@
 #include "cgi.h"
 #include "header.h"
 #include "cookie.h"
+#include "upload.h"
+#include "json.h"
+#include "form.h"
+#include "fcgi.h"
+#include "response.h"
@@ -41,6 +41,8 @@
 #define __cgixx_cookie_h
 
 #include <string>
+#include <memory_resource>
+#include <cstddef>
 #include <ctime>
 
 namespace cgixx {
@@ -60,10 +62,17 @@ class cookie {
 public:
 	cookie(const cgi& initcgi, const std::string& name,
 		const std::string& value="");
+	cookie(const cgi& initcgi, const std::string& name,
+		const std::string& value, std::pmr::memory_resource* resource);
 	cookie(const std::string& name, const std::string& value="");
+	cookie(const std::string& name, const std::string& value,
+		std::pmr::memory_resource* resource);
 	cookie(const cookie& copy);
+	cookie(cookie&& other) noexcept;
 	~cookie();
 
+	cookie& operator=(cookie&& other) noexcept;
+
 	void setvalue(const std::string& value);
 	void setdomain(const std::string& domain);
 	void setpath(const std::string& path);
@@ -74,13 +83,19 @@ public:
 	const std::string& getvalue() const;
 
 	// Get cookie string
-	std::string get();
+	std::string get() const;
 
 private:
 	cookie();
 	cookie& operator=(const cookie&);
 
+	void init(const cgi& initcgi, const std::string& name,
+		const std::string& value);
+
 	cookie_impl* imp;
+
+	// Storage for *imp, which is built here unless it does not fit.
+	alignas(std::max_align_t) unsigned char storage[224];
 };
 
 } // end namespace cgixx
@@ -0,0 +1,133 @@
+/*
+ * fcgi.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __cgixx_fcgi_h
+#define __cgixx_fcgi_h
+
+#include <cgixx/cgi.h>
+#include <ostream>
+
+namespace cgixx {
+
+// Forward declarations
+struct fcgi_server_impl;
+struct fcgi_request_impl;
+
+/**
+ * The fcgi_request class holds one request accepted by an fcgi_server.
+ * The request parameters and body are available through getcgi(), and
+ * anything written to out() (for example the string returned by
+ * header::get()) is sent to the web server as FCGI_STDOUT records.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+class fcgi_request {
+public:
+	fcgi_request();
+	~fcgi_request();
+
+	/// Get the cgi instance for this request.
+	cgi& getcgi();
+
+	/// Get the stream that sends FCGI_STDOUT records.
+	std::ostream& out();
+
+	/// Get the stream that sends FCGI_STDERR records.
+	std::ostream& err();
+
+	/// Complete the request.
+	void finish(unsigned appstatus = 0);
+
+private:
+	friend class fcgi_server;
+
+	// There is no copy constructor.
+	fcgi_request(const fcgi_request&);
+	// There is no copy operator.
+	fcgi_request& operator=(const fcgi_request&);
+
+	fcgi_request_impl* imp;
+};
+
+
+/**
+ * The fcgi_server class implements the FastCGI responder role.  One
+ * process accepts connections from the web server on a listening socket
+ * and handles requests one after another:
+ *
+ * <pre>
+ * cgixx::fcgi_server server;
+ * cgixx::fcgi_request req;
+ * while (!server.accept(req)) {
+ *     cgixx::header header;
+ *     req.out() << header.get() << "Hello";
+ *     req.finish();
+ * }
+ * </pre>
+ *
+ * Requests are not multiplexed over a connection.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+class fcgi_server {
+public:
+	explicit fcgi_server(int listenfd = 0);
+	~fcgi_server();
+
+	/// Wait for the next request.
+	bool accept(fcgi_request& req);
+
+	/// Set the options used to build the cgi of each request.
+	void setoptions(const cgioptions& opts);
+
+	/// Check whether the process was started as a FastCGI application.
+	static bool isfastcgi(int listenfd = 0);
+
+private:
+	// There is no copy constructor.
+	fcgi_server(const fcgi_server&);
+	// There is no copy operator.
+	fcgi_server& operator=(const fcgi_server&);
+
+	fcgi_server_impl* imp;
+};
+
+} // end namespace cgixx
+
+#endif // __cgixx_fcgi_h
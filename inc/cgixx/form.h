@@ -0,0 +1,343 @@
+/*
+ * form.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_form_h
+#define __cgixx_form_h
+
+#include <cgixx/cgi.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+namespace cgixx {
+
+/**
+ * The formdefault template gives the type of the default value of a
+ * form field.  A std::string field defaults from a string_view so that
+ * a form can be constexpr.
+ */
+template <typename T>
+struct formdefault { typedef T type; };
+
+template <>
+struct formdefault<std::string> { typedef std::string_view type; };
+
+/**
+ * The formfield structure declares one field of a form: the variable
+ * identifier, the member of S it is stored in, its default value and
+ * whether it must be sent.  Use field or requiredfield to make one.
+ */
+template <typename S, typename T>
+struct formfield {
+	static_assert(isconvertible<T>::value ||
+		std::is_same<T, std::string>::value ||
+		std::is_same<T, std::string_view>::value,
+		"a form field must be a bool, short, int, long, long long, "
+		"their unsigned types, float, double, long double, std::string "
+		"or std::string_view member");
+
+	/// Identifier of the CGI variable.
+	std::string_view name;
+
+	/// Member receiving the value.
+	T S::* member;
+
+	/// Value stored if the variable is not sent or cannot be converted.
+	typename formdefault<T>::type def;
+
+	/// The variable must be sent.
+	bool required;
+};
+
+/**
+ * Declare an optional form field.
+ *
+ * @param	name	Identifier of the CGI variable.
+ * @param	member	Member receiving the value.
+ * @param	def	Value stored if the variable is not sent or cannot
+ *			be converted.
+ * @return	The field.
+ */
+template <typename S, typename T>
+constexpr formfield<S, T> field(std::string_view name, T S::* member,
+	typename formdefault<T>::type def = typename formdefault<T>::type())
+{
+	return formfield<S, T>{ name, member, def, false };
+}
+
+/**
+ * Declare a form field that must be sent, and not empty.
+ *
+ * @param	name	Identifier of the CGI variable.
+ * @param	member	Member receiving the value.
+ * @return	The field.
+ */
+template <typename S, typename T>
+constexpr formfield<S, T> requiredfield(std::string_view name, T S::* member)
+{
+	return formfield<S, T>{ name, member, typename formdefault<T>::type(),
+		true };
+}
+
+/**
+ * The formerror structure reports the first field that could not be
+ * bound.
+ */
+struct formerror {
+	/// Identifier of the field.
+	std::string_view field;
+
+	/// get_missing for a required field, or why its value was rejected.
+	geterrors error;
+};
+
+/**
+ * Hash a field name for the perfect hash table of a form.
+ */
+constexpr std::uint32_t formhash(std::string_view name, std::uint32_t seed)
+{
+	std::uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+	for (std::size_t i = 0; i < name.size(); ++i)
+		h = (h ^ static_cast<unsigned char>(name[i])) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+/**
+ * The form class binds the CGI variables of a request to the members of
+ * a structure S in one pass over the variables.  Declare a form
+ * constexpr with makeform, so that a perfect hash of the field names is
+ * computed at compile time and each variable is matched to its field
+ * with one hash and one compare:
+ *
+ *	struct search { std::string query; int page; bool exact; };
+ *
+ *	constexpr auto searchform = cgixx::makeform(
+ *		cgixx::requiredfield("q", &search::query),
+ *		cgixx::field("page", &search::page, 1),
+ *		cgixx::field("exact", &search::exact));
+ *
+ *	search s;
+ *	cgixx::formerror err;
+ *	if (searchform.bind(cgi, s, err))
+ *		... err.field was missing or not valid ...
+ *
+ * Numbers and booleans are converted as a typed cgi::get does.  A
+ * string_view member refers into the cgi instance and is valid for its
+ * lifetime.  Only the first value of a variable is bound, and a value
+ * sent empty counts as not sent.  Variables that are not fields are
+ * ignored.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+template <typename S, typename... T>
+class form {
+public:
+	/// Number of fields.
+	static constexpr std::size_t fieldcount = sizeof...(T);
+
+	static_assert(fieldcount > 0 && fieldcount < 255,
+		"a form has 1 to 254 fields");
+
+	/// Declare the fields of a form.
+	constexpr explicit form(const formfield<S, T>&... f) :
+		fields(f...), names{ f.name... }, required{ f.required... },
+		slots(), seed(0), mask(0)
+	{
+		for (std::size_t i = 0; i < fieldcount; ++i)
+			for (std::size_t j = i + 1; j < fieldcount; ++j)
+				if (names[i] == names[j])
+					throw cgiexception("duplicate form field");
+		std::size_t size = 2;
+		while (size < fieldcount * 2)
+			size*= 2;
+		for (mask = size - 1; ; ) {
+			for (seed = 0; seed < 64 || mask + 1 == tablesize; ++seed)
+				if (!place())
+					return;
+			mask = mask * 2 + 1;
+		}
+	}
+
+	/**
+	 * Bind the variables of a request to a structure.  Every field is
+	 * first set to its default, so all members are set even on failure.
+	 *
+	 * @param	request	The request.
+	 * @param	out	Reference to structure to receive the values.
+	 * @param	error	Reference to receive the first failure.
+	 * @return	false on success; true if a required field was not
+	 *		sent or a value could not be converted.
+	 */
+	bool bind(const cgi& request, S& out, formerror& error) const
+	{ return bindall(request, out, error, std::index_sequence_for<T...>()); }
+
+	/**
+	 * Bind the variables of a request to a structure.
+	 *
+	 * @param	request	The request.
+	 * @param	out	Reference to structure to receive the values.
+	 * @return	false on success; true if a required field was not
+	 *		sent or a value could not be converted.
+	 */
+	bool bind(const cgi& request, S& out) const
+	{
+		formerror error;
+		return bind(request, out, error);
+	}
+
+private:
+	// Smallest table size with at most 1 field in 8 slots.
+	static constexpr std::size_t tablesize =
+		fieldcount <= 4 ? 32 : fieldcount <= 8 ? 64 : fieldcount <= 16 ?
+		128 : fieldcount <= 32 ? 256 : fieldcount <= 64 ? 512 :
+		fieldcount <= 128 ? 1024 : 2048;
+
+	typedef geterrors (*setter)(const form&, S&, std::string_view);
+
+	/*
+	 * Place every field in the table with the current seed and mask;
+	 * return true on a collision.
+	 */
+	constexpr bool place()
+	{
+		for (std::size_t i = 0; i <= mask; ++i)
+			slots[i] = 0;
+		for (std::size_t i = 0; i < fieldcount; ++i) {
+			std::uint32_t h = formhash(names[i], seed) & mask;
+			if (slots[h])
+				return true;
+			slots[h] = static_cast<unsigned char>(i + 1);
+		}
+		return false;
+	}
+
+	/*
+	 * Find the field of a variable, or fieldcount if it is not one.
+	 */
+	std::size_t findfield(std::string_view id) const
+	{
+		unsigned char s = slots[formhash(id, seed) & mask];
+		return s && names[s - 1] == id ? s - 1 : fieldcount;
+	}
+
+	template <typename V>
+	static geterrors assign(std::string_view raw, V& value)
+	{ return convertvalue(raw, value); }
+
+	static geterrors assign(std::string_view raw, std::string& value)
+	{
+		value.assign(raw.data(), raw.size());
+		return get_ok;
+	}
+
+	static geterrors assign(std::string_view raw, std::string_view& value)
+	{
+		value = raw;
+		return get_ok;
+	}
+
+	template <std::size_t I>
+	static geterrors setfield(const form& f, S& out, std::string_view raw)
+	{ return assign(raw, out.*(std::get<I>(f.fields).member)); }
+
+	template <std::size_t I>
+	void setdefault(S& out) const
+	{ out.*(std::get<I>(fields).member) = std::get<I>(fields).def; }
+
+	template <std::size_t... I>
+	bool bindall(const cgi& request, S& out, formerror& error,
+		std::index_sequence<I...>) const
+	{
+		static constexpr setter setters[] = { &form::template setfield<I>... };
+		bool seen[fieldcount] = {};
+		std::string_view id, raw;
+
+		error.field = std::string_view();
+		error.error = get_ok;
+		(setdefault<I>(out), ...);
+		// Only the first value of a matching variable is decoded.
+		for (unsigned n = 0; !request.getvariable(n, id); ++n) {
+			std::size_t i = findfield(id);
+			if (i == fieldcount || request.getvariablevalue(n, 0, raw) ||
+				raw.empty())
+				continue;
+			seen[i] = true;
+			geterrors e = setters[i](*this, out, raw);
+			if (e != get_ok && error.error == get_ok) {
+				error.field = names[i];
+				error.error = e;
+			}
+		}
+		for (std::size_t i = 0; i < fieldcount; ++i)
+			if (required[i] && !seen[i] && error.error == get_ok) {
+				error.field = names[i];
+				error.error = get_missing;
+			}
+		return error.error != get_ok;
+	}
+
+	std::tuple< formfield<S, T>... > fields;
+	std::string_view names[fieldcount];
+	bool required[fieldcount];
+	unsigned char slots[tablesize];	// field index + 1, or 0 if empty
+	std::uint32_t seed;
+	std::uint32_t mask;
+};
+
+/**
+ * Make a form from its fields, for use with auto:
+ *
+ *	constexpr auto f = cgixx::makeform(cgixx::field(...), ...);
+ *
+ * @param	fields	The fields, all members of the same structure.
+ * @return	The form.
+ */
+template <typename S, typename... T>
+constexpr form<S, T...> makeform(const formfield<S, T>&... fields)
+{
+	return form<S, T...>(fields...);
+}
+
+} // end namespace cgixx
+
+#endif // __cgixx_form_h
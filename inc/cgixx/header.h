@@ -41,12 +41,17 @@
 #define __cgixx_header_h
 
 #include <string>
+#include <memory_resource>
+#include <string_view>
+#include <cstddef>
 
 namespace cgixx {
 
 // Forward declaration
 struct header_impl;
+struct frozenheader_impl;
 class cookie;
+class frozenheader;
 
 /**
  * The header class is used to generate valid HTTP headers to be
@@ -64,10 +69,14 @@ class cookie;
 class header {
 public:
 	header();
+	explicit header(std::pmr::memory_resource* resource);
+	header(header&& other) noexcept;
 	~header();
 
+	header& operator=(header&& other) noexcept;
+
 	/// Set Content-length header.
-	void setlength(unsigned length);
+	void setlength(unsigned length, bool always = false);
 	
 	/// Set Content-type header.
 	void settype(const std::string& contenttype);
@@ -88,13 +97,102 @@ public:
 	void redirect(const std::string& location);
 
 	/// Add a cookie object to the header.
-	void addcookie(cookie& value);
+	void addcookie(const cookie& value);
 
 	/// Get the formatted header string.
 	std::string get() const;
 
+	/// Write the header, and optionally a body, to a file descriptor.
+	bool write(int fd, const char* body = 0, std::size_t length = 0) const;
+
+	/// Freeze the header into a prebuilt template.
+	frozenheader freeze() const;
+
 private:
+	friend class frozenheader;
+
 	header_impl* imp;
+
+	// Storage for *imp, which is built here unless it does not fit.
+	alignas(std::max_align_t) unsigned char storage[256];
+};
+
+/**
+ * The parts of a response header that change from one response to the
+ * next, filled into a frozenheader.  An empty location, or a length of 0
+ * without haslength, falls back to the value frozen from the header, if
+ * any.
+ */
+struct headerpatch
+{
+	/// The Content-length, or 0 to omit it unless haslength is set.
+	unsigned length;
+	/// Send length even if it is 0, as for an empty body.
+	bool haslength;
+	/// The Location, or empty to omit it.
+	std::string_view location;
+	/// Set-Cookie lines as returned by cookie::get, or 0.
+	const std::string_view* cookies;
+	/// The number of Set-Cookie lines.
+	std::size_t cookiecount;
+
+	headerpatch() : length(0), haslength(false), cookies(0), cookiecount(0)
+	{}
+};
+
+/**
+ * The frozenheader class holds a header that was configured once,
+ * typically at startup, as a prebuilt byte buffer with slots for the
+ * parts that change per response: Date, Content-length, Location and
+ * Set-Cookie.  Producing a header is then a few block copies of the
+ * frozen text with the slots written in between, instead of formatting
+ * every line again.  For example:
+ *
+ * cgixx::header h;
+ * h.settype("application/json");
+ * h.setheader("Cache-Control", "no-store");
+ * static const cgixx::frozenheader json(h.freeze());
+ *
+ * cgixx::headerpatch patch;
+ * patch.length = body.length();
+ * json.write(STDOUT_FILENO, patch, body.data(), body.length());
+ *
+ * The Expires header and any cookies added to the header are frozen as
+ * they were formatted when the header was frozen.  A frozenheader is
+ * never modified after it is built, so it may be shared between threads.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+class frozenheader {
+public:
+	explicit frozenheader(const header& source);
+	frozenheader(frozenheader&& other) noexcept;
+	~frozenheader();
+
+	/// Get the length of the header for a patch.
+	std::size_t size(const headerpatch& patch = headerpatch()) const;
+
+	/// Copy the header for a patch into a buffer of size() bytes.
+	std::size_t copy(char* out, const headerpatch& patch = headerpatch()) const;
+
+	/// Append the header for a patch to a string.
+	void append(std::string& out, const headerpatch& patch = headerpatch()) const;
+
+	/// Get the header for a patch.
+	std::string get(const headerpatch& patch = headerpatch()) const;
+
+	/// Write the header for a patch, and optionally a body, to a file descriptor.
+	bool write(int fd, const headerpatch& patch = headerpatch(),
+		const char* body = 0, std::size_t length = 0) const;
+
+private:
+	frozenheader_impl* imp;
+
+	// There is no copy constructor.
+	frozenheader(const frozenheader&);
+	// There is no copy operator.
+	frozenheader& operator=(const frozenheader&);
 };
 
 } // end namespace cgixx
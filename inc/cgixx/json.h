@@ -0,0 +1,130 @@
+/*
+ * json.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_json_h
+#define __cgixx_json_h
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace cgixx {
+
+/// Forward declaration, for internal use
+struct jsondocument;
+
+/**
+ * The jsontypes enumeration lists the types of a jsonvalue.
+ */
+enum jsontypes {
+	json_none = 0,	///< The value does not exist
+	json_null,
+	json_false,
+	json_true,
+	json_number,
+	json_string,
+	json_array,
+	json_object
+};
+
+/**
+ * The jsonvalue class refers to one value of an application/json request
+ * body.  It is a small handle that may be copied freely; the text it
+ * returns is a view of the body held by the cgi instance, and remains
+ * valid for the lifetime of that instance.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+class jsonvalue {
+public:
+	jsonvalue() : doc(0), node(0), parent(0) {}
+
+	/// Check whether this refers to a value.
+	bool exists() const { return doc != 0; }
+
+	/// Get the type of the value.
+	jsontypes gettype() const;
+
+	/// Get the text of a string, or the literal text of a number.
+	std::string_view getstring() const;
+
+	/// Get a number as a double.
+	bool getnumber(double& value) const;
+
+	/// Get a number as an integer.
+	bool getnumber(long long& value) const;
+
+	/// Get a boolean.
+	bool getbool(bool& value) const;
+
+	/// Get the number of elements or members.
+	std::size_t size() const;
+
+	/// Get the first element or member value.
+	jsonvalue first() const;
+
+	/// Get the next element or member value.
+	jsonvalue next() const;
+
+	/// Get the name of an object member.
+	std::string_view getkey() const;
+
+	/// Get an element of an array.
+	jsonvalue at(std::size_t index) const;
+
+	/// Get a member of an object.
+	jsonvalue member(std::string_view key) const;
+
+	/// Find a value by JSON pointer, such as "/items/0/id".
+	jsonvalue find(std::string_view pointer) const;
+
+private:
+	friend struct jsondocument;
+
+	jsonvalue(const jsondocument* d, std::uint32_t n, std::uint32_t p) :
+		doc(d), node(n), parent(p) {}
+
+	const jsondocument* doc;
+	std::uint32_t node;	// index in the tape
+	std::uint32_t parent;	// index of the enclosing container + 1, or 0
+};
+
+} // end namespace cgixx
+
+#endif // __cgixx_json_h
@@ -0,0 +1,121 @@
+/*
+ * response.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_response_h
+#define __cgixx_response_h
+
+#include <cgixx/header.h>
+#include <ostream>
+#include <string_view>
+#include <memory_resource>
+#include <cstddef>
+
+namespace cgixx {
+
+// Forward declaration
+struct response_impl;
+
+/**
+ * The response class collects the body of a response in a buffer that
+ * grows as needed and sends it, with its header, when finished.  The
+ * Content-length is filled in from the size of the body, so the web
+ * server can keep the client's connection open, and the header and body
+ * go out with a single writev:
+ *
+ * <pre>
+ * cgixx::response res;
+ * res.gethead().settype("text/plain");
+ * res.out() << "Hello, " << name;
+ * res.finish();
+ * </pre>
+ *
+ * Bodies too large to buffer can be sent as they are produced by calling
+ * stream(), which sends the header at once, without a Content-length
+ * unless one was set, and then sends the body in blocks.  Large buffered
+ * bodies are kept in memory mapped pages, which grow without copying
+ * where the system allows.  A response that is destroyed without being
+ * finished sends nothing, unless it is streaming, in which case the rest
+ * of the body is sent.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+class response {
+public:
+	explicit response(int fd = 1, std::pmr::memory_resource* resource = 0);
+	explicit response(std::ostream& sink,
+		std::pmr::memory_resource* resource = 0);
+	~response();
+
+	/// Get the header to send with the response.
+	header& gethead();
+
+	/// Send a frozen header instead of gethead().
+	void usefrozen(const frozenheader& frozen,
+		const headerpatch& patch = headerpatch());
+
+	/// Append to the body.
+	void write(const char* text, std::size_t length);
+
+	/// Append to the body.
+	void write(std::string_view text);
+
+	/// Get a stream that appends to the body.
+	std::ostream& out();
+
+	/// Get the number of body bytes buffered and not yet sent.
+	std::size_t length() const;
+
+	/// Send the header now and the body as it is written.
+	bool stream();
+
+	/// Send the response.
+	bool finish();
+
+private:
+	// There is no copy constructor.
+	response(const response&);
+	// There is no copy operator.
+	response& operator=(const response&);
+
+	response_impl* imp;
+};
+
+} // end namespace cgixx
+
+#endif // __cgixx_response_h
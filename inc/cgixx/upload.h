@@ -0,0 +1,100 @@
+/*
+ * upload.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __cgixx_upload_h
+#define __cgixx_upload_h
+
+#include <string>
+#include <cstddef>
+
+namespace cgixx {
+
+// Forward declarations
+struct upload_impl;
+class multipartparser;
+
+/**
+ * The upload class describes a file sent in a multipart/form-data
+ * request.  Small files are kept in memory.  Files larger than
+ * cgioptions::spillthreshold are written to an unlinked temporary file
+ * while the request is read, and are available through getfd() or as a
+ * memory mapped view through data().  Uploads are owned by the cgi
+ * instance that parsed them.
+ *
+ * @author	Isaac W. Foraker
+ *
+ */
+class upload {
+public:
+	~upload();
+
+	/// Get the name of the form field.
+	const std::string& getname() const;
+
+	/// Get the file name sent by the client.
+	const std::string& getfilename() const;
+
+	/// Get the content type sent by the client.
+	const std::string& gettype() const;
+
+	/// Get the size of the file.
+	std::size_t size() const;
+
+	/// Check whether the file is held in memory.
+	bool inmemory() const;
+
+	/// Get the contents of the file.
+	const char* data() const;
+
+	/// Get the descriptor of the temporary file.
+	int getfd() const;
+
+private:
+	friend class multipartparser;
+
+	explicit upload(upload_impl* i);
+	// There is no copy constructor.
+	upload(const upload&);
+	// There is no copy operator.
+	upload& operator=(const upload&);
+
+	upload_impl* imp;
+};
+
+} // end namespace cgixx
+
+#endif // __cgixx_upload_h
@@ -37,27 +37,93 @@
 
 #include <cgixx/cgi.h>
 #include "cgi_impl.h"
-#include <cstdio>
-#include <cctype>
+#include "pmralloc.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 
 namespace cgixx {
 
-static const std::string cgixx_version("1.07");
+static const std::string cgixx_version("1.08");
 
 /**
  * Construct an instance of cgi.
  */
-cgi::cgi() : imp(new cgi_impl)
+cgi::cgi()
+    : imp(newobject<cgi_impl>(std::pmr::get_default_resource(), nullptr,
+        nullptr, cgioptions()))
 {
 }
 
 
+/**
+ * Construct an instance of cgi with the specified options.
+ *
+ * @param   opts    Options for processing the request.
+ */
+cgi::cgi(const cgioptions& opts)
+    : imp(newobject<cgi_impl>(resourceor(opts.resource), nullptr, nullptr,
+        opts))
+{
+}
+
+
+/**
+ * Construct an instance of cgi from a supplied environment and request
+ * body instead of the process environment and standard input.  This is
+ * used by persistent servers, such as fcgi_server, which receive many
+ * requests in one process.
+ *
+ * @param   env     The CGI meta-variables of the request.
+ * @param   input   The request body.
+ * @param   opts    Options for processing the request.
+ */
+cgi::cgi(const environment& env, const std::string& input,
+    const cgioptions& opts)
+    : imp(newobject<cgi_impl>(resourceor(opts.resource), &env, &input, opts))
+{
+}
+
+
+/**
+ * Construct an instance of cgi by taking over the request of another,
+ * which may then only be assigned to or destroyed.  Nothing is copied.
+ *
+ * @param   other   The cgi to move from.
+ */
+cgi::cgi(cgi&& other) noexcept : imp(other.imp)
+{
+    other.imp = 0;
+}
+
+
 /**
  * Destruct *this instance of cgi.
  */
 cgi::~cgi()
 {
-    delete imp;
+    if (imp)
+        deleteobject(imp->resource, imp);
+}
+
+
+/**
+ * Take over the request of another cgi, which may then only be assigned
+ * to or destroyed.
+ *
+ * @param   other   The cgi to move from.
+ * @return  *this
+ */
+cgi& cgi::operator=(cgi&& other) noexcept
+{
+    if (this != &other) {
+        if (imp)
+            deleteobject(imp->resource, imp);
+        imp = other.imp;
+        other.imp = 0;
+    }
+    return *this;
 }
 
 
@@ -72,6 +138,20 @@ const std::string& cgi::libver()
 }
 
 
+/**
+ * Parse the query string or body, and the cookies, if that was deferred
+ * with cgioptions::deferparse.  Otherwise this does nothing.  Throws
+ * cgiexception if the body cannot be read or parsed.
+ *
+ * @return  nothing
+ */
+void cgi::parse()
+{
+    imp->getvars();
+    imp->getcookies();
+}
+
+
 /**
  * Get the count of values for the CGI variable with the specified id.
  * This count is decremented with each call to get.
@@ -79,12 +159,12 @@ const std::string& cgi::libver()
  * @param   id      Identifier of variable.
  * @return  Count of values for vairable.
  */
-unsigned cgi::count(const std::string& id) const
+unsigned cgi::count(std::string_view id) const
 {
-    ParameterList::const_iterator it(imp->vars.find(id));
-    if (it == imp->vars.end())
+    const ParameterList::group* g = imp->getvars().find(id);
+    if (!g)
         return 0;
-    return it->second.size();
+    return ParameterList::remaining(*g);
 }
 
 
@@ -96,10 +176,10 @@ unsigned cgi::count(const std::string& id) const
  * @return  true if variable exists;
  * @return  false if variable does not exist.
  */
-bool cgi::exists(const std::string& id)
+bool cgi::exists(std::string_view id)
 {
-    ParameterList::const_iterator it(imp->vars.find(id));
-    return it != imp->vars.end();
+    const ParameterList::group* g = imp->getvars().find(id);
+    return g && ParameterList::remaining(*g);
 }
 
 
@@ -112,20 +192,170 @@ bool cgi::exists(const std::string& id)
  * @param   value   Reference to string to receive value of variable.
  * @return  false on success; true when no more values are available.
  */
-bool cgi::get(const std::string& id, std::string& value)
+bool cgi::get(std::string_view id, std::string& value)
+{
+    ParameterList::group* g = imp->getvars().find(id);
+    if (!g || !ParameterList::remaining(*g))
+        return true;
+    value = imp->getvars().value(imp->getvars().entries[g->first + g->next++]);
+    return false;
+}
+
+
+/**
+ * Get the count of all values for the CGI variable with the specified
+ * id.  Unlike count, this is not affected by calls to get.
+ *
+ * @param   id      Identifier of variable.
+ * @return  Count of values for variable.
+ */
+unsigned cgi::countvalues(std::string_view id) const
+{
+    const ParameterList::group* g = imp->getvars().find(id);
+    return g ? g->count : 0;
+}
+
+
+/**
+ * Get a value of the CGI variable with the specified id, by its position
+ * among all values of the variable.  Unlike get, this does not remove
+ * the value.  The view remains valid for the lifetime of *this cgi.
+ *
+ * @param   id      Identifier of CGI variable.
+ * @param   index   Position of the value, counting from 0.
+ * @param   value   Reference to view to receive value of variable.
+ * @return  false on success; true if there is no such value.
+ */
+bool cgi::getvalue(std::string_view id, unsigned index,
+    std::string_view& value) const
 {
-    ParameterList::iterator it(imp->vars.find(id));
-    if (it == imp->vars.end())
+    ParameterList::group* g = imp->getvars().find(id);
+    if (!g || index >= g->count)
         return true;
-    strqueue& sq = it->second;
-    value = sq.front();
-    sq.pop();
-    if (it->second.empty())
-        imp->vars.erase(it);
+    value = imp->getvars().value(imp->getvars().entries[g->first + index]);
     return false;
 }
 
 
+/*
+ * Convert a whole value to a number with from_chars, which neither skips
+ * white space nor accepts a leading +, so a + is skipped here.  An empty
+ * value is invalid.
+ */
+template <typename T>
+static geterrors fromchars(std::string_view raw, T& value)
+{
+    if (raw.empty())
+        return get_invalid;
+    const char* first = raw.data();
+    const char* last = first + raw.size();
+    if (*first == '+' && last - first > 1 && first[1] != '-')
+        ++first;
+    T converted;
+    std::from_chars_result r = std::from_chars(first, last, converted);
+    if (r.ec == std::errc::result_out_of_range)
+        return get_range;
+    if (r.ec != std::errc() || r.ptr != last)
+        return get_invalid;
+    value = converted;
+    return get_ok;
+}
+
+
+/*
+ * As fromchars, for floating point, rejecting inf and nan.
+ */
+template <typename T>
+static geterrors fromcharsfinite(std::string_view raw, T& value)
+{
+    T converted;
+    geterrors e = fromchars(raw, converted);
+    if (e == get_ok && !std::isfinite(converted))
+        return get_invalid;
+    if (e == get_ok)
+        value = converted;
+    return e;
+}
+
+
+/*
+ * Compare a value to a lower case word, ignoring case.
+ */
+static bool isword(std::string_view raw, std::string_view word)
+{
+    if (raw.size() != word.size())
+        return false;
+    for (std::string_view::size_type i = 0; i < raw.size(); ++i)
+        if ((raw[i] | 0x20) != word[i])
+            return false;
+    return true;
+}
+
+
+geterrors convertvalue(std::string_view raw, bool& value)
+{
+    if (raw == "1" || isword(raw, "true") || isword(raw, "on") ||
+        isword(raw, "yes"))
+        value = true;
+    else if (raw == "0" || isword(raw, "false") || isword(raw, "off") ||
+        isword(raw, "no"))
+        value = false;
+    else
+        return get_invalid;
+    return get_ok;
+}
+
+geterrors convertvalue(std::string_view raw, short& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, unsigned short& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, int& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, unsigned& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, long& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, unsigned long& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, long long& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, unsigned long long& value)
+{ return fromchars(raw, value); }
+
+geterrors convertvalue(std::string_view raw, float& value)
+{ return fromcharsfinite(raw, value); }
+
+geterrors convertvalue(std::string_view raw, double& value)
+{ return fromcharsfinite(raw, value); }
+
+geterrors convertvalue(std::string_view raw, long double& value)
+{ return fromcharsfinite(raw, value); }
+
+
+/**
+ * Get all values of the CGI variable with the specified id, in the order
+ * they were sent.  Unlike get, this does not remove any values.
+ *
+ * @param   id      Identifier of CGI variable.
+ * @return  Range of values, empty if the variable does not exist.
+ */
+cgi::valuerange cgi::getvalues(std::string_view id) const
+{
+    ParameterList::group* g = imp->getvars().find(id);
+    if (!g)
+        return valuerange();
+    const std::string_view* first = imp->getvars().values(*g);
+    return valuerange(first, first + g->count);
+}
+
+
 /**
  * Get the list of variable identifiers.  If all values for a variable
  * are retrieved using get, the associated variable identifier will not
@@ -136,11 +366,88 @@ bool cgi::get(const std::string& id, std::string& value)
  */
 void cgi::getvariablelist(identifierlist& idlist) const
 {
-    ParameterList::const_iterator it(imp->vars.begin()),
-        end(imp->vars.end());
+    std::pmr::vector<ParameterList::group>::const_iterator
+        it(imp->getvars().groups.begin()), end(imp->getvars().groups.end());
     idlist.clear();
     for (; it != end; ++it)
-        idlist.push_back(it->first);
+        if (ParameterList::remaining(*it))
+            idlist.push_back(std::string(imp->getvars().str(it->name)));
+}
+
+
+/**
+ * Get the count of distinct variable identifiers, including those whose
+ * values have all been retrieved with get.
+ *
+ * @return  Count of variable identifiers.
+ */
+unsigned cgi::countvariables() const
+{
+    return unsigned(imp->getvars().groups.size());
+}
+
+
+/**
+ * Get a variable identifier by position, to walk every variable without
+ * copying names or decoding any values.  Variables are ordered by
+ * identifier.  The view remains valid for the lifetime of *this cgi.
+ *
+ * @param   n       Position of the variable, counting from 0.
+ * @param   id      Reference to view to receive the identifier.
+ * @return  false on success; true if n is past the last variable.
+ */
+bool cgi::getvariable(unsigned n, std::string_view& id) const
+{
+    ParameterList& vars = imp->getvars();
+    if (n >= vars.groups.size())
+        return true;
+    id = vars.str(vars.groups[n].name);
+    return false;
+}
+
+
+/**
+ * Get one value of a variable by the position of the variable, as given
+ * to getvariable, without retrieving it.  With lazydecode, only this
+ * value is decoded.
+ *
+ * @param   n       Position of the variable, counting from 0.
+ * @param   index   Position of the value, counting from 0.
+ * @param   value   Reference to view to receive the value.
+ * @return  false on success; true if there is no such value.
+ */
+bool cgi::getvariablevalue(unsigned n, unsigned index,
+    std::string_view& value) const
+{
+    ParameterList& vars = imp->getvars();
+    if (n >= vars.groups.size() || index >= vars.groups[n].count)
+        return true;
+    value = vars.value(vars.entries[vars.groups[n].first + index]);
+    return false;
+}
+
+
+/**
+ * Get a variable identifier and all of its values by position, to walk
+ * every variable without copying names.  Variables are ordered by
+ * identifier.  The views remain valid for the lifetime of *this cgi.
+ *
+ * @param   n       Position of the variable, counting from 0.
+ * @param   id      Reference to view to receive the identifier.
+ * @param   values  Reference to receive all values of the variable.
+ * @return  false on success; true if n is past the last variable.
+ */
+bool cgi::getvariable(unsigned n, std::string_view& id,
+    valuerange& values) const
+{
+    ParameterList& vars = imp->getvars();
+    if (n >= vars.groups.size())
+        return true;
+    const ParameterList::group& g = vars.groups[n];
+    const std::string_view* first = vars.values(g);
+    id = vars.str(g.name);
+    values = valuerange(first, first + g.count);
+    return false;
 }
 
 
@@ -151,12 +458,12 @@ void cgi::getvariablelist(identifierlist& idlist) const
  * @param   id      Identifier of cookie.
  * @return  Count of values for specified cookie.
  */
-unsigned cgi::countcookie(const std::string& id) const
+unsigned cgi::countcookie(std::string_view id) const
 {
-    ParameterList::const_iterator it(imp->cookies.find(id));
-    if (it == imp->cookies.end())
+    const ParameterList::group* g = imp->getcookies().find(id);
+    if (!g)
         return 0;
-    return it->second.size();
+    return ParameterList::remaining(*g);
 }
 
 
@@ -168,10 +475,10 @@ unsigned cgi::countcookie(const std::string& id) const
  * @return  true if cookie exists;
  * @return  false if cookie does not exist.
  */
-bool cgi::cookieexists(const std::string& id)
+bool cgi::cookieexists(std::string_view id)
 {
-    ParameterList::const_iterator it(imp->cookies.find(id));
-    return it != imp->cookies.end();
+    const ParameterList::group* g = imp->getcookies().find(id);
+    return g && ParameterList::remaining(*g);
 }
 
 
@@ -184,20 +491,35 @@ bool cgi::cookieexists(const std::string& id)
  * @param   value   Reference to string to receive value of cookie.
  * @return  false on success; true when no more values are available.
  */
-bool cgi::getcookie(const std::string& id, std::string& value)
+bool cgi::getcookie(std::string_view id, std::string& value)
 {
-    ParameterList::iterator it(imp->cookies.find(id));
-    if (it == imp->cookies.end())
+    ParameterList::group* g = imp->getcookies().find(id);
+    if (!g || !ParameterList::remaining(*g))
         return true;
-    strqueue& sq = it->second;
-    value = sq.front();
-    sq.pop();
-    if (it->second.empty())
-        imp->cookies.erase(it);
+    value = imp->getcookies().value(imp->getcookies().entries[g->first + g->next++]);
     return false;
 }
 
 
+/**
+ * Get the first value of the cookie with the specified id, as sent.
+ * Unlike getcookie, this does not remove the value.  With
+ * cgioptions::deferparse, until the cookies are otherwise used this
+ * scans the Cookie header for just this cookie, and a value that needs
+ * no decoding is returned as a view of the header, so cookies that are
+ * never read are never stored.  The view remains valid for the lifetime
+ * of *this cgi.
+ *
+ * @param   id      Identifier of cookie.
+ * @param   value   Reference to view to receive value of cookie.
+ * @return  false on success; true if there is no such cookie.
+ */
+bool cgi::findcookie(std::string_view id, std::string_view& value) const
+{
+    return imp->findcookie(id, value);
+}
+
+
 /**
  * Get the list of cookie identifiers.  If all values for a cookie
  * are retrieved using get, the associated cookie identifier will not
@@ -208,11 +530,85 @@ bool cgi::getcookie(const std::string& id, std::string& value)
  */
 void cgi::getcookielist(identifierlist& idlist) const
 {
-    ParameterList::const_iterator it(imp->cookies.begin()),
-        end(imp->cookies.end());
+    std::pmr::vector<ParameterList::group>::const_iterator
+        it(imp->getcookies().groups.begin()), end(imp->getcookies().groups.end());
     idlist.clear();
     for (; it != end; ++it)
-        idlist.push_back(it->first);
+        if (ParameterList::remaining(*it))
+            idlist.push_back(std::string(imp->getcookies().str(it->name)));
+}
+
+
+/**
+ * Get the number of files uploaded by the form field with the
+ * specified id in a multipart/form-data request.
+ *
+ * @param   id      Identifier of form field.
+ * @return  Number of files uploaded.
+ */
+unsigned cgi::countupload(std::string_view id) const
+{
+    unsigned n = 0;
+    for (std::size_t i = 0; i != imp->getuploads().size(); ++i)
+        if (imp->getuploads()[i]->getname() == id)
+            ++n;
+    return n;
+}
+
+
+/**
+ * Get a file uploaded by the form field with the specified id in a
+ * multipart/form-data request.  Files are numbered from 0 in the order
+ * they were sent.  Unlike get, this does not consume the file.  The
+ * upload remains owned by *this cgi.
+ *
+ * @param   id      Identifier of form field.
+ * @param   index   Which of the field's files to get.
+ * @return  Pointer to the upload;
+ * @return  0 if there is no such file.
+ */
+const upload* cgi::getupload(std::string_view id, unsigned index) const
+{
+    for (std::size_t i = 0; i != imp->getuploads().size(); ++i)
+        if (imp->getuploads()[i]->getname() == id && !index--)
+            return imp->getuploads()[i].get();
+    return 0;
+}
+
+
+/**
+ * Get a list of all form fields that uploaded files.
+ *
+ * @param   idlist      Reference to list to receive field IDs.
+ * @return  nothing
+ */
+void cgi::getuploadlist(identifierlist& idlist) const
+{
+    idlist.clear();
+    for (std::size_t i = 0; i != imp->getuploads().size(); ++i)
+    {
+        const std::string& name = imp->getuploads()[i]->getname();
+        if (std::find(idlist.begin(), idlist.end(), name) == idlist.end())
+            idlist.push_back(name);
+    }
+}
+
+
+/**
+ * Get a value of the request body by JSON pointer, when the request was
+ * a POST with an application/json (or +json) content type.  The body is
+ * parsed in place once; values refer into it and remain valid for the
+ * lifetime of *this cgi.  A malformed body throws cgiexception when the
+ * request is parsed.
+ *
+ * @param   pointer JSON pointer such as "/user/name", or empty for the
+ *                  whole body.
+ * @return  The value, which does not exist if the body was not JSON or
+ *          the path does not exist.
+ */
+jsonvalue cgi::getjson(std::string_view pointer) const
+{
+    return imp->getjson().root().find(pointer);
 }
 
 
@@ -227,75 +623,89 @@ void cgi::getcookielist(identifierlist& idlist) const
  */
 bool cgi::getheader(headers hid, std::string& copy) const
 {
-    switch (hid) {
-    case header_request_method:
-        imp->getenvvar(copy, "REQUEST_METHOD");
-        break;
-    case header_query_string:
-        imp->getenvvar(copy, "QUERY_STRING");
-        break;
-    case header_server_software:
-        imp->getenvvar(copy, "SERVER_SOFTWARE");
-        break;
-    case header_server_name:
-        imp->getenvvar(copy, "SERVER_NAME");
-        break;
-    case header_gateway_interface:
-        imp->getenvvar(copy, "GATEWAY_INTERFACE");
-        break;
-    case header_server_protocol:
-        imp->getenvvar(copy, "SERVER_PROTOCOL");
-        break;
-    case header_server_port:
-        imp->getenvvar(copy, "SERVER_PORT");
-        break;
-    case header_path_info:
-        imp->getenvvar(copy, "PATH_INFO");
-        break;
-    case header_path_translated:
-        imp->getenvvar(copy, "PATH_TRANSLATED");
-        break;
-    case header_script_name:
-        imp->getenvvar(copy, "SCRIPT_NAME");
-        break;
-    case header_remote_addr:
-        imp->getenvvar(copy, "REMOTE_ADDR");
-        break;
-    case header_remote_host:
-        imp->getenvvar(copy, "REMOTE_HOST");
-        break;
-    case header_auth_type:
-        imp->getenvvar(copy, "AUTH_TYPE");
-        break;
-    case header_remote_user:
-        imp->getenvvar(copy, "REMOTE_USER");
-        break;
-    case header_remote_ident:
-        imp->getenvvar(copy, "REMOTE_IDENT");
-        break;
-    case header_content_type:
-        imp->getenvvar(copy, "CONTENT_TYPE");
-        break;
-    case header_content_length:
-        imp->getenvvar(copy, "CONTENT_LENGTH");
-        break;
-    case header_http_accept:
-        imp->getenvvar(copy, "HTTP_ACCEPT");
-        break;
-    case header_http_user_agent:
-        imp->getenvvar(copy, "HTTP_USER_AGENT");
-        break;
-    case header_http_cookie:
-        imp->getenvvar(copy, "HTTP_COOKIE");
-        break;
-    default:
-        copy.erase();
+    std::string_view value;
+    bool invalid = getheader(hid, value);
+    copy.assign(value.data(), value.length());
+    return invalid;
+}
+
+
+/**
+ * Get a view of the value of the specified variable, which remains valid
+ * for the lifetime of *this cgi.  The variables are captured when *this
+ * cgi is constructed, so this does not search the environment.  If an
+ * invalid header is specified, getheader returns true.
+ *
+ * @param   hid     The header identifier from the headers enumeration.
+ * @param   value   Reference to view to receive value of header.
+ * @return  false on success;
+ * @return  true if an invalid header is specified.
+ */
+bool cgi::getheader(headers hid, std::string_view& value) const
+{
+    if (hid < 0 || hid >= headercount) {
+        value = std::string_view();
+        return true;
+    }
+    value = imp->headertable[hid];
+    return false;
+}
+
+
+/**
+ * Get a view of the value of a CGI meta-variable or HTTP_* variable by
+ * its environment variable name, such as "HTTP_ACCEPT_LANGUAGE".  The
+ * view remains valid for the lifetime of *this cgi.
+ *
+ * @param   name    Name of the environment variable.
+ * @param   value   Reference to view to receive value of variable.
+ * @return  false on success;
+ * @return  true if the variable was not set or is not captured.
+ */
+bool cgi::getmetavar(std::string_view name, std::string_view& value) const
+{
+    const std::string_view* v = imp->findenv(name);
+    if (!v) {
+        value = std::string_view();
         return true;
     }
+    value = *v;
     return false;
 }
 
 
+/**
+ * Get a view of the value of a request header by its HTTP name, such as
+ * "If-None-Match", which is looked up as HTTP_IF_NONE_MATCH.  For a
+ * literal name, a constexpr httpheader avoids converting the name on
+ * each call.
+ *
+ * @param   name    HTTP name of the header, in any case.
+ * @param   value   Reference to view to receive value of header.
+ * @return  false on success;
+ * @return  true if the client did not send the header.
+ */
+bool cgi::getrequestheader(std::string_view name, std::string_view& value) const
+{
+    // Build the name on the stack, unless it is unusually long.
+    char local[128];
+    std::string longname;
+    char* envname = local;
+    if (name.length() + 5 > sizeof(local)) {
+        longname.resize(name.length() + 5);
+        envname = &longname[0];
+    }
+    std::size_t len = 0;
+    if (!iscontentheader(name)) {
+        std::memcpy(envname, "HTTP_", 5);
+        len = 5;
+    }
+    for (std::size_t i = 0; i != name.length(); ++i)
+        envname[len++] = httpenvchar(name[i]);
+    return getmetavar(std::string_view(envname, len), value);
+}
+
+
 /**
  * Get the method of the request in the form of an enumerated id.
  *
@@ -307,32 +717,17 @@ methods cgi::getmethod() const
 }
 
 /**
- * Convert a string for use in a URL.  All non-alphanumeric characters in the
- * string will be converted to %hex notation.
+ * Convert a string for use in a URL.  All characters except letters,
+ * digits and '_' are converted to %hex notation, and spaces to '+'.
  *
  * @param   instr       Input string
  * @param   outstr      Output string
+ * @return  Reference to outstr.
  */
 std::string& makesafestring(const std::string& instr, std::string& outstr)
 {
     outstr.erase();
-    std::size_t i, end = instr.length();
-    char buf[17];
-    for (i = 0; i != end; ++i)
-    {
-        unsigned char c = instr[i];
-        if (std::isalnum(c) || c == '_')
-            outstr+= c;
-        else if (c == ' ')
-            outstr+= '+';
-        else
-        {
-            std::sprintf(buf, "%02X", c);
-            outstr+= '%';
-            outstr+= buf;
-        }
-    }
-    return outstr;
+    return appendsafestring(instr, outstr);
 }
 
 } // end namespace cgixx
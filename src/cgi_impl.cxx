@@ -40,22 +40,239 @@
 #endif
 
 #include "cgi_impl.h"
-#include <iostream>
+#include "cookiescan.h"
+#include "pmralloc.h"
 #include <memory>
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
 #include <ctime>
+#include <algorithm>
+#ifdef _WIN32
+#include <iostream>
+#else
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#define environ _environ
+#else
+extern char** environ;
+#endif
 
 namespace cgixx {
 
-cgi_impl::cgi_impl()
+namespace {
+
+// Environment variable names, in the order of the headers enumeration.
+const char* const headernames[headercount] = {
+	"REQUEST_METHOD",
+	"QUERY_STRING",
+	"SERVER_SOFTWARE",
+	"SERVER_NAME",
+	"GATEWAY_INTERFACE",
+	"SERVER_PROTOCOL",
+	"SERVER_PORT",
+	"PATH_INFO",
+	"PATH_TRANSLATED",
+	"SCRIPT_NAME",
+	"REMOTE_ADDR",
+	"REMOTE_HOST",
+	"AUTH_TYPE",
+	"REMOTE_USER",
+	"REMOTE_IDENT",
+	"CONTENT_TYPE",
+	"CONTENT_LENGTH",
+	"HTTP_ACCEPT",
+	"HTTP_USER_AGENT",
+	"HTTP_COOKIE"
+};
+
+// Other variables captured with the CGI meta-variables, sorted.
+const std::string_view extravars[] = {
+	"DOCUMENT_ROOT",
+	"HTTPS",
+	"REDIRECT_STATUS",
+	"REMOTE_PORT",
+	"REQUEST_SCHEME",
+	"REQUEST_URI",
+	"SCRIPT_FILENAME",
+	"SERVER_ADDR",
+	"SERVER_ADMIN"
+};
+
+/*
+ * Check whether name is a variable that is captured: an HTTP_* header,
+ * a CGI meta-variable, or a common server extension.
+ *
+ */
+bool ismetavar(std::string_view name)
 {
-	std::string temp;
-	getenvvar(temp, "REQUEST_METHOD", "GET");
-	if (temp== "GET")
-		method = method_get;
-	else if (temp == "POST")
+	if (name.compare(0, 5, "HTTP_") == 0)
+		return true;
+	for (int i = 0; i != headercount; ++i)
+		if (name == headernames[i])
+			return true;
+	return std::binary_search(extravars,
+		extravars + sizeof(extravars) / sizeof(extravars[0]), name);
+}
+
+// Largest block read from STDIN or passed to a parser at once.
+const std::size_t blocksize = 65536;
+
+#ifdef _WIN32
+/*
+ * Read the body from std::cin.
+ *
+ */
+template <class Parser>
+void readbody(unsigned long clength, Parser& parser)
+{
+	char buf[1024];  // Read in up to 1 KB at a time.
+	unsigned x;
+	// clength will be decreased to 0 when all data is read.
+	while (clength > 0) {
+		// Note: if the client stops sending data here, the web server
+		// should automatically timeout and kill the connection.
+		std::cin.read(buf, sizeof(buf));
+		x = std::cin.gcount();
+		if (x) {
+			if (x > clength) {
+				// Client is sending too much data, so abort.
+				throw cgiexception("Client sent more data than defined by CONTENT_LENGTH");
+			}
+			// Decrease clength by the amount received.
+			clength-= x;
+			parser.feed(buf, x);
+		} else if (std::cin.eof()) {
+			// There is no more input
+			throw cgiexception("Expected more data on STDIN");
+		}
+	}
+}
+#else
+/*
+ * If STDIN is a regular file, such as a saved request being replayed,
+ * map the body instead of reading it.  Returns false if STDIN cannot be
+ * mapped.
+ *
+ */
+template <class Parser>
+bool mapbody(unsigned long clength, Parser& parser)
+{
+	struct stat st;
+	if (::fstat(0, &st) || !S_ISREG(st.st_mode))
+		return false;
+	off_t offset = ::lseek(0, 0, SEEK_CUR);
+	if (offset < 0 || offset > st.st_size)
+		return false;
+	if (static_cast<unsigned long long>(st.st_size - offset) < clength)
+		throw cgiexception("Expected more data on STDIN");
+	if (static_cast<unsigned long long>(st.st_size - offset) > clength)
+		throw cgiexception("Client sent more data than defined by CONTENT_LENGTH");
+
+	// The mapping must start on a page boundary.
+	off_t start = offset - offset % ::sysconf(_SC_PAGESIZE);
+	std::size_t skip = offset - start;
+	void* map = ::mmap(0, skip + clength, PROT_READ, MAP_PRIVATE, 0, start);
+	if (map == MAP_FAILED)
+		return false;
+	struct unmapper {
+		void* addr;
+		std::size_t len;
+		~unmapper() { ::munmap(addr, len); }
+	} unmap = { map, skip + clength };
+	::madvise(map, skip + clength, MADV_SEQUENTIAL);
+
+	// Pass the body in blocks to keep the parsers' buffers small.
+	const char* body = static_cast<const char*>(map) + skip;
+	for (unsigned long pos = 0; pos < clength; pos+= blocksize)
+		parser.feed(body + pos, std::min<unsigned long>(blocksize, clength - pos));
+	::lseek(0, offset + clength, SEEK_SET);
+	return true;
+}
+
+/*
+ * Read the body from STDIN with read(2), into a buffer sized once from
+ * CONTENT_LENGTH.
+ *
+ */
+template <class Parser>
+void readbody(unsigned long clength, Parser& parser)
+{
+	if (mapbody(clength, parser))
+		return;
+
+	// One byte more than expected lets excess data be noticed.
+	std::size_t size = clength < blocksize ? clength + 1 : blocksize;
+	std::unique_ptr<char[]> buf(new char[size]);
+	// clength will be decreased to 0 when all data is read.
+	while (clength > 0) {
+		// Note: if the client stops sending data here, the web server
+		// should automatically timeout and kill the connection.
+		ssize_t x = ::read(0, buf.get(), size);
+		if (x > 0) {
+			if (static_cast<unsigned long>(x) > clength) {
+				// Client is sending too much data, so abort.
+				throw cgiexception("Client sent more data than defined by CONTENT_LENGTH");
+			}
+			// Decrease clength by the amount received.
+			clength-= x;
+			parser.feed(buf.get(), x);
+		} else if (x == 0) {
+			// There is no more input
+			throw cgiexception("Expected more data on STDIN");
+		} else if (errno != EINTR)
+			throw cgiexception("Error reading STDIN");
+	}
+}
+#endif
+
+/*
+ * Pass the request body to parser a block at a time, taking it from
+ * input if the caller supplied it, or else from STDIN.
+ *
+ */
+template <class Parser>
+void readbody(const std::string_view* input, unsigned long clength,
+	Parser& parser)
+{
+	if (input) {
+		// The body was supplied by the caller.
+		if (input->length() > clength)
+			throw cgiexception("Client sent more data than defined by CONTENT_LENGTH");
+		if (input->length() < clength)
+			throw cgiexception("Expected more data on STDIN");
+		parser.feed(input->data(), input->length());
+	} else
+		readbody(clength, parser);
+	parser.finish();
+}
+
+} // end anonymous namespace
+
+cgi_impl::cgi_impl(const cgi::environment* env, const std::string* in,
+	const cgioptions& o)
+	: resource(resourceor(o.resource)), vars(resource), cookies(resource),
+	uploads(resource), json(resource), opts(o), input(resource),
+	hasinput(in != 0), varsloaded(false), cookiesloaded(false),
+	failed(false), error(resource), envarena(resource), envvars(resource)
+{
+	vars.lazy = cookies.lazy = opts.lazydecode;
+	cookies.kind = "cookie";
+	vars.maxentries = opts.limits.maxparams;
+	cookies.maxentries = opts.limits.maxcookies;
+	vars.maxname = cookies.maxname = opts.limits.maxname;
+	vars.maxvalue = cookies.maxvalue = opts.limits.maxvalue;
+
+	snapshot(env);
+
+	std::string_view temp(headertable[header_request_method]);
+	if (temp == "POST")
 		method = method_post;
 	else if (temp == "HEAD")
 		method = method_head;
@@ -64,210 +281,203 @@ cgi_impl::cgi_impl()
 	else
 		method = method_get;
 
-	getenvvar(temp, "CONTENT_LENGTH");
-	unsigned long clength = std::atoi(temp.c_str());
+	if (opts.deferparse) {
+		// The caller's body may not outlive the constructor.
+		if (in)
+			input = *in;
+		return;
+	}
+	std::string_view body(in ? std::string_view(*in) : std::string_view());
+	parsevars(in ? &body : 0);
+	parsecookies();
+}
+
+
+/*
+ * Parse the query string, or the body of a POST request.
+ *
+ */
+void cgi_impl::parsevars(const std::string_view* input)
+{
+	unsigned long clength = std::strtoul(
+		std::string(headertable[header_content_length]).c_str(), 0, 10);
 
 	if (method == method_post) {
-		// Read STDIN
-		if (clength) {
-			char buf[1024];  // Read in up to 1 KB at a time.
-			unsigned x;
-			temp.erase();
-			// clength will be decreased to 0 when all data is read.
-			while (clength > 0) {
-				// Note: if the client stops sending data here, the web server
-				// should automatically timeout and kill the connection.
-				std::cin.read(buf, sizeof(buf));
-				x = std::cin.gcount();
-				if (x) {
-					if (x > clength) {
-						// Client is sending too much data, so abort.
-						throw cgiexception("Client sent more data than defined by CONTENT_LENGTH");
-					}
-					// Decrease clength by the amount received.
-					clength-= x;
-					temp.append(buf, x);
-				} else if (std::cin.eof()) {
-					// There is no more input
-					throw cgiexception("Expected more data on STDIN");
-				}
-			}
-			parseparams(temp);
+		std::string boundary;
+		if (opts.limits.maxbody && clength > opts.limits.maxbody)
+			throw cgiexception("Request body too large");
+		if (!input && !clength)
+			;	// no parameters
+		else if (ismultipart(std::string(headertable[header_content_type]),
+			boundary)) {
+			if (boundary.empty())
+				throw cgiexception("Missing multipart/form-data boundary");
+			multipartparser parser(boundary, vars, uploads, opts);
+			readbody(input, clength, parser);
+		} else if (isjson(headertable[header_content_type])) {
+			json.begin(clength);
+			readbody(input, clength, json);
+		} else {
+			vars.begin(clength);
+			readbody(input, clength, vars);
 		}
-		// else no parameters
 	} else {	// GET, HEAD, PUT
 		// Parse QUERY_STRING
-		getenvvar(temp, "QUERY_STRING");
-		parseparams(temp);
+		vars.parseparams(headertable[header_query_string]);
 	}
+	varsloaded = true;
+}
+
 
-	getenvvar(temp, "HTTP_COOKIE");
-	parsecookies(temp);
+void cgi_impl::parsecookies()
+{
+	cookies.parsecookies(headertable[header_http_cookie]);
+	cookiesloaded = true;
 }
 
+
 /*
- * Helper function that gets an environment variable into a string, or
- * sets the default value if available.
+ * Find the first value of a cookie.  Until the cookies are parsed, the
+ * header is scanned for the name and a value that needs no decoding is
+ * returned as a view of it; otherwise the cookies are parsed.
  *
  */
-void cgi_impl::getenvvar(std::string& dest, const char* name, const char* defval)
+bool cgi_impl::findcookie(std::string_view name, std::string_view& value)
 {
-	const char* t;
-	if ( (t = std::getenv(name)) )
-		dest = t;
-	else if (defval)
-		dest = defval;
-	else
-		dest.erase();
+	if (!cookiesloaded) {
+		cookiescanner scanner(headertable[header_http_cookie]);
+		cookiescanner::token t;
+		std::string decoded;
+		for (;;) {
+			if (scanner.next(t))
+				return true;
+			if (t.nameescaped) {
+				decoded.assign(t.name.data(), t.name.length());
+				decoded.resize(cgi2text(&decoded[0], decoded.length()));
+				if (decoded != name)
+					continue;
+			} else if (t.name != name)
+				continue;
+			if (t.valueescaped)
+				break;
+			value = t.value;
+			return false;
+		}
+	}
+	ParameterList::group* g = getcookies().find(name);
+	if (!g)
+		return true;
+	value = cookies.value(cookies.entries[g->first]);
+	return false;
 }
 
 
 /*
- * Parse cookies from HTTP_COOKIE environment variable.
- * Format: id=val; id=val; id=val
+ * Parse deferred input.  If that fails, the same exception is thrown
+ * again on every later attempt instead of exposing partial results.
  *
  */
-void cgi_impl::parsecookies(const std::string& cookielist)
+void cgi_impl::loadvars()
 {
-	std::string id, val;
-	std::size_t pos = 0, newpos, len = cookielist.length();
-	while ((pos < len) &&
-		((newpos = cookielist.find('=', pos)) != std::string::npos))
-	{
-		id = cgi2text(cookielist.substr(pos, newpos-pos));
-		pos = newpos + 1;	// skip '='
-		newpos = cookielist.find(';', pos);
-		if (newpos == std::string::npos)
-		{
-			val = cgi2text(cookielist.substr(pos));
-		}
-		else
-		{
-			val = cgi2text(cookielist.substr(pos, newpos-pos));
-			// Skip whitespace
-			++newpos;
-			while (std::isspace(cookielist[newpos]))
-				++newpos;
-			pos = newpos;	// skip ':'
-		}
-		cookies[id].push(val);
+	if (failed)
+		throw cgiexception(std::string(error));
+	std::string_view body(input);
+	try {
+		parsevars(hasinput ? &body : 0);
+	} catch (const cgiexception& e) {
+		failed = true;
+		error = e.what();
+		throw;
 	}
+	input.clear();
+	input.shrink_to_fit();
 }
 
-void cgi_impl::parseparams(const std::string& paramlist)
+
+/*
+ * Copy the CGI meta-variables and HTTP_* variables from env, or from the
+ * process environment if env is 0, in one pass.  Values are then read
+ * from the copy instead of searching the environment each time.
+ *
+ */
+void cgi_impl::snapshot(const cgi::environment* env)
 {
-	if (paramlist.empty())
-		return;
-	if (paramlist.find('=') == std::string::npos)
-	{
-		// ISINDEX
-		vars["query_string"].push(cgi2text(paramlist));
-	}
-	else
-	{
-		// identifiers are delimited by = and values are delimited by
-		// & or \0.
-		std::string id, val;
-		std::size_t pos = 0, newpos, len = paramlist.length();
-		while ((pos < len) &&
-			((newpos = paramlist.find('=', pos)) != std::string::npos))
-		{
-			id = cgi2text(paramlist.substr(pos, newpos-pos));
-			pos = newpos + 1;	// skip '='
-			newpos = paramlist.find('&', pos);
-			if (newpos == std::string::npos)
-			{
-				val = cgi2text(paramlist.substr(pos));
+	std::pmr::vector<envvar> found(resource);
+	std::size_t size = 0;
+	if (env) {
+		cgi::environment::const_iterator it(env->begin()), end(env->end());
+		for (; it != end; ++it)
+			if (ismetavar(it->first)) {
+				envvar v = { it->first, it->second };
+				found.push_back(v);
+				size+= it->first.length() + it->second.length();
 			}
-			else
-			{
-				val = cgi2text(paramlist.substr(pos, newpos-pos));
-				pos = newpos + 1;	// skip '&'
+	} else {
+		for (char** e = environ; *e; ++e) {
+			const char* eq = std::strchr(*e, '=');
+			if (!eq)
+				continue;
+			std::string_view name(*e, eq - *e);
+			if (ismetavar(name)) {
+				envvar v = { name, std::string_view(eq + 1) };
+				found.push_back(v);
+				size+= name.length() + v.value.length();
 			}
-			vars[id].push(val);
 		}
 	}
-}
 
-std::string cgi2text(const std::string& cgistr)
-{
-	std::string textstr;
-	std::string::const_iterator it(cgistr.begin()), end(cgistr.end());
-
-	for (; it != end; ++it)
-	{
-		if (*it == '%')
-		{
-			++it;
-			if (it == end)
-				break;
-			unsigned char temp = hex2dec(*it) * 16;
-			++it;
-			if (it == end)
-				break;
-			temp+= hex2dec(*it);
-			textstr+= temp;
-		}
-		else if (*it == '+')
-			textstr+= ' ';
-		else
-			textstr+= *it;
+	// Copy into an arena that is never resized, so the views stay valid.
+	envarena.reserve(size);
+	envvars.reserve(found.size());
+	for (std::size_t i = 0; i != found.size(); ++i) {
+		std::size_t offset = envarena.length();
+		envarena.append(found[i].name);
+		envarena.append(found[i].value);
+		envvar v = {
+			std::string_view(envarena.data() + offset, found[i].name.length()),
+			std::string_view(envarena.data() + offset + found[i].name.length(),
+				found[i].value.length())
+		};
+		envvars.push_back(v);
 	}
+	std::sort(envvars.begin(), envvars.end(),
+		[](const envvar& a, const envvar& b) { return a.name < b.name; });
 
-	return textstr;
+	for (int i = 0; i != headercount; ++i) {
+		const std::string_view* value = findenv(headernames[i]);
+		if (value)
+			headertable[i] = *value;
+	}
 }
 
-std::string text2cgi(const std::string& textstr)
+
+/*
+ * Find a captured variable by name.
+ *
+ */
+const std::string_view* cgi_impl::findenv(std::string_view name) const
 {
-	std::string cgistr;
-	std::string::const_iterator it(textstr.begin()), end(textstr.end());
-
-	for (; it != end; ++it)
-	{
-		if (std::isalnum(*it))
-			cgistr+= *it;
-		else
-		{
-			cgistr+= '%';
-			cgistr+= dec2hex(*it / 16);
-			cgistr+= dec2hex(*it % 16);
-		}
-	}
-	return cgistr;
+	std::pmr::vector<envvar>::const_iterator it(std::lower_bound(envvars.begin(),
+		envvars.end(), name,
+		[](const envvar& v, std::string_view n) { return v.name < n; }));
+	if (it == envvars.end() || it->name != name)
+		return 0;
+	return &it->value;
 }
 
-unsigned char dec2hex(char c)
+
+std::string cgi2text(const std::string& cgistr)
 {
-	if (c < 0)
-		return 0;
-	else if (c < 10)
-		return c + '0';
-	else if (c < 16)
-		return c - 10 + 'A';
-	else
-		return '0';
+	std::string textstr(cgistr);
+	if (!textstr.empty())
+		textstr.resize(cgi2text(&textstr[0], textstr.length()));
+	return textstr;
 }
 
-unsigned char hex2dec(char c)
+std::string text2cgi(const std::string& textstr)
 {
-	switch (c) {
-	case 'A':
-	case 'B':
-	case 'C':
-	case 'D':
-	case 'E':
-	case 'F':
-		return c - 'A' + 10;
-	case 'a':
-	case 'b':
-	case 'c':
-	case 'd':
-	case 'e':
-	case 'f':
-		return c - 'a' + 10;
-	default:
-		return c - '0';
-	}
+	std::string cgistr;
+	return text2cgi(textstr, cgistr);
 }
 
 } // end namespace cgixx
@@ -40,38 +40,90 @@
 
 #include "compat.h"
 
+#include "paramlist.h"
+#include "multipart.h"
+#include "jsontape.h"
 #include <cgixx/cgi.h>
 #include <string>
-#include <map>
-#include <queue>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
 
 namespace cgixx {
 
-typedef std::queue< std::string > strqueue;
-typedef std::map< std::string, strqueue > ParameterList;
+// Number of members of the headers enumeration.
+const int headercount = header_http_cookie + 1;
 
 struct cgi_impl {
-	cgi_impl();
-	void parseparams(const std::string& paramlist);
+	cgi_impl(const cgi::environment* env, const std::string* input,
+		const cgioptions& opts);
 
-	// Store an environment variable in the specified string.
-	void getenvvar(std::string& dest, const char* name, const char* defval=0);
+	// Capture the CGI meta-variables and HTTP_* variables.
+	void snapshot(const cgi::environment* env);
 
-	void parsecookies(const std::string&);
+	// Find a captured variable, or 0 if it was not set.
+	const std::string_view* findenv(std::string_view name) const;
 
-	// Map of parameters.
+	// Parse the query string or body, and the cookies.
+	void parsevars(const std::string_view* input);
+	void parsecookies();
+
+	// Find the first value of a cookie without parsing the others.
+	bool findcookie(std::string_view name, std::string_view& value);
+
+	// Parse deferred input on first use.
+	void loadvars();
+	ParameterList& getvars()
+	{ if (!varsloaded) loadvars(); return vars; }
+	multipartparser::uploadlist& getuploads()
+	{ if (!varsloaded) loadvars(); return uploads; }
+	const jsondocument& getjson()
+	{ if (!varsloaded) loadvars(); return json; }
+	ParameterList& getcookies()
+	{ if (!cookiesloaded) parsecookies(); return cookies; }
+
+	// Source of all memory of the request, including *this.
+	std::pmr::memory_resource* resource;
+
+	// Parameters and cookies.
 	ParameterList vars;
 	ParameterList cookies;
 
+	// Files from a multipart/form-data request, in the order sent.
+	multipartparser::uploadlist uploads;
+
+	// An application/json body.
+	jsondocument json;
+
+	// State for deferred parsing.
+	cgioptions opts;
+	std::pmr::string input;	// copy of a supplied body
+	bool hasinput;
+	bool varsloaded;
+	bool cookiesloaded;
+	bool failed;		// parsing threw error
+	std::pmr::string error;
+
 	// The method with which the request was made.
 	methods method;
+
+	// The captured variables, as views of envarena sorted by name.
+	struct envvar {
+		std::string_view name;
+		std::string_view value;
+	};
+	std::pmr::string envarena;
+	std::pmr::vector<envvar> envvars;
+
+	// Value of each member of headers; empty if not set.
+	std::string_view headertable[headercount];
 };
 
 std::string cgi2text(const std::string& cgistr);
+std::size_t cgi2text(char* buf, std::size_t len);
 std::string text2cgi(const std::string& textstr);
-
-unsigned char hex2dec(char c);
-unsigned char dec2hex(char c);
+std::string& text2cgi(std::string_view textstr, std::string& cgistr);
 
 } // end namespace cgixx
 
@@ -36,11 +36,10 @@
  */
 
 #include "cgi_impl.h"
-#include "timedefs.inl"
+#include "httpdate.h"
+#include "pmralloc.h"
 #include <cgixx/cookie.h>
 #include <cgixx/cgi.h>
-#include <cstdio>
-#include <cctype>
 #include <ctime>
 
 namespace cgixx {
@@ -48,11 +47,18 @@ namespace cgixx {
 // expire=Wdy, DD-Mon-YYYY HH:MM:SS GMT
 
 struct cookie_impl {
+	explicit cookie_impl(std::pmr::memory_resource* r) : resource(r),
+		expire(r), path(r), domain(r), secure(false) {}
+
+	std::pmr::memory_resource* resource;
+
+	// Returned by reference as std::string.
 	std::string name;
 	std::string value;
-	std::string expire;
-	std::string path;
-	std::string domain;
+
+	std::pmr::string expire;
+	std::pmr::string path;
+	std::pmr::string domain;
 	bool secure;
 };
 
@@ -67,13 +73,29 @@ struct cookie_impl {
  */
 cookie::cookie(const cgi& initcgi, const std::string& name,
 			   const std::string& value)
-	: imp(new cookie_impl)
+	: imp(makeimpl<cookie_impl>(storage, std::pmr::get_default_resource(),
+		std::pmr::get_default_resource()))
 {
-	imp->name = name;
-	imp->value = value;
-	initcgi.getheader(header_server_name, imp->domain);
-	initcgi.getheader(header_script_name, imp->path);
-	imp->secure = false;
+	init(initcgi, name, value);
+}
+
+
+/**
+ * Construct a cookie on a cgi session, allocating from a memory
+ * resource.
+ *
+ * @param	initcgi		Reference to cgi instance.
+ * @param	name		Name of this cookie.
+ * @param	value		Value of this cookie.
+ * @param	resource	The memory resource, which must outlive *this
+ *						cookie, or 0 for the default resource.
+ */
+cookie::cookie(const cgi& initcgi, const std::string& name,
+			   const std::string& value, std::pmr::memory_resource* resource)
+	: imp(makeimpl<cookie_impl>(storage, resourceor(resource),
+		resourceor(resource)))
+{
+	init(initcgi, name, value);
 }
 
 
@@ -84,21 +106,40 @@ cookie::cookie(const cgi& initcgi, const std::string& name,
  * @param	value		Value of this cookie.
  */
 cookie::cookie(const std::string& name, const std::string& value)
-	: imp(new cookie_impl)
+	: imp(makeimpl<cookie_impl>(storage, std::pmr::get_default_resource(),
+		std::pmr::get_default_resource()))
+{
+	imp->name = name;
+	imp->value = value;
+}
+
+
+/**
+ * Construct a basic cookie, allocating from a memory resource.
+ *
+ * @param	name		Name of this cookie.
+ * @param	value		Value of this cookie.
+ * @param	resource	The memory resource, which must outlive *this
+ *						cookie, or 0 for the default resource.
+ */
+cookie::cookie(const std::string& name, const std::string& value,
+			   std::pmr::memory_resource* resource)
+	: imp(makeimpl<cookie_impl>(storage, resourceor(resource),
+		resourceor(resource)))
 {
 	imp->name = name;
 	imp->value = value;
-	imp->secure = false;
 }
 
 
 /**
- * Construct a copy of another cookie.
+ * Construct a copy of another cookie, from the same memory resource.
  *
  * @param	copy	Reference to cookie to copy.
  */
 cookie::cookie(const cookie& copy)
-	: imp(new cookie_impl)
+	: imp(makeimpl<cookie_impl>(storage, copy.imp->resource,
+		copy.imp->resource))
 {
 	imp->name = copy.imp->name;
 	imp->value = copy.imp->value;
@@ -109,12 +150,65 @@ cookie::cookie(const cookie& copy)
 }
 
 
+/*
+ * Set the name and value, and the domain and path from a cgi instance.
+ */
+void cookie::init(const cgi& initcgi, const std::string& name,
+	const std::string& value)
+{
+	std::string_view view;
+	imp->name = name;
+	imp->value = value;
+	if (!initcgi.getheader(header_server_name, view))
+		imp->domain = view;
+	if (!initcgi.getheader(header_script_name, view))
+		imp->path = view;
+}
+
+
 /**
  * Destroy *this instance of cookie.
  */
 cookie::~cookie()
 {
-	delete imp;
+	destroyimpl(storage, imp);
+}
+
+
+/**
+ * Construct a cookie by moving the contents of another, which may then
+ * only be assigned to or destroyed.  No memory is allocated.
+ *
+ * @param	other	The cookie to move from.
+ */
+cookie::cookie(cookie&& other) noexcept : imp(other.imp)
+{
+	if (isinline(other.storage, other.imp))
+		imp = new (storage) cookie_impl(std::move(*other.imp));
+	else
+		other.imp = 0;
+}
+
+
+/**
+ * Replace the contents of *this cookie by moving those of another,
+ * which may then only be assigned to or destroyed.
+ *
+ * @param	other	The cookie to move from.
+ * @return	*this
+ */
+cookie& cookie::operator=(cookie&& other) noexcept
+{
+	if (this != &other)
+	{
+		destroyimpl(storage, imp);
+		imp = other.imp;
+		if (isinline(other.storage, other.imp))
+			imp = new (storage) cookie_impl(std::move(*other.imp));
+		else
+			other.imp = 0;
+	}
+	return *this;
 }
 
 
@@ -172,7 +266,7 @@ void cookie::setsecure(bool requiressl)
  *
  * @param	expire		The expire parameter my be either the RFC 850
  *						encoded date of expiration, or an offset string
- *						containing "(-)123(M|H|S|D|W|m|Y)".  I.e. a
+ *						containing "(+|-)123(M|H|S|D|W|m|Y)".  I.e. a
  *						number (negative numbers generally cause the
  *						document to expire immediately) followed by a
  *						time modifier.  M=minute, H=hour, S=second,
@@ -182,57 +276,15 @@ void cookie::setsecure(bool requiressl)
  */
 bool cookie::setexpire(const std::string& expire)
 {
-	unsigned pos = 0;
-
-	if (expire[pos] == '-')
-		++pos;
-	if (std::isdigit(expire[pos]))
+	std::time_t when;
+	if (expireoffset(expire, when))
 	{
-		while (std::isdigit(expire[++pos]))
-			;
-		unsigned duration = std::atoi(expire.substr(0, pos).c_str());
-		switch (expire[pos])
-		{
-		case 'M':	// minute
-			duration*= 60;
-			break;
-		case 'H':
-			duration*= 3600;
-			break;
-		case 'D':
-		case 'd':
-			duration*= 84600;
-			break;
-		case 'W':
-		case 'w':
-			duration*= 84600*7;
-			break;
-		case 'm':
-			duration*= 84600*30;
-			break;
-		case 'Y':
-		case 'y':
-			duration*= 84600*365;
-			break;
-		case 'S':
-		case 's':
-			break;
-		default:
-			imp->expire = expire;
-			return true;
-		}
-		std::time_t timer = std::time(NULL) + duration;
-		struct std::tm* ts = std::gmtime(&timer);
-		char buf[72];
-		std::sprintf(buf, "%s, %02u-%s-%04u %02u:%02u:%02u GMT",
-			weekday[ts->tm_wday], ts->tm_mday, month[ts->tm_mon],
-			ts->tm_year + 1900, ts->tm_hour, ts->tm_min, ts->tm_sec);
-		imp->expire = buf;
-		return false;
+		imp->expire = expire;
+		return true;
 	}
-
-	imp->expire = expire;
-	return true;
+	char buf[httpdatelength];
+	imp->expire.assign(buf, formathttpdate(when, buf));
+	return false;
 }
 
 
@@ -264,12 +316,12 @@ const std::string& cookie::getvalue() const
  *
  * @return	The formatted cookie header.
  */
-std::string cookie::get()
+std::string cookie::get() const
 {
 	std::string setmsg("Set-Cookie: ");
-	setmsg+= text2cgi(imp->name);
+	text2cgi(imp->name, setmsg);
 	setmsg+= '=';
-	setmsg+= text2cgi(imp->value);
+	text2cgi(imp->value, setmsg);
 	if (!imp->expire.empty())
 	{
 		setmsg+= "; expires=";
@@ -0,0 +1,259 @@
+/*
+ * cookiescan.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "cookiescan.h"
+#include <cctype>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define CGIXX_X86_SIMD
+#	include <immintrin.h>
+#endif
+
+namespace cgixx {
+
+namespace {
+
+void classify_scalar(const unsigned char* p, blockmasks& m)
+{
+	m.equals = m.semicolons = m.escapes = 0;
+	for (int i = 0; i != 64; ++i)
+	{
+		std::uint64_t bit = std::uint64_t(1) << i;
+		if (p[i] == '=')
+			m.equals|= bit;
+		else if (p[i] == ';')
+			m.semicolons|= bit;
+		else if (p[i] == '%' || p[i] == '+')
+			m.escapes|= bit;
+	}
+}
+
+#ifdef CGIXX_X86_SIMD
+
+__attribute__((target("sse2")))
+void classify_sse2(const unsigned char* p, blockmasks& m)
+{
+	const __m128i equals = _mm_set1_epi8('=');
+	const __m128i semicolon = _mm_set1_epi8(';');
+	const __m128i pct = _mm_set1_epi8('%');
+	const __m128i plus = _mm_set1_epi8('+');
+
+	m.equals = m.semicolons = m.escapes = 0;
+	for (int i = 0; i != 64; i+= 16)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		m.equals|= std::uint64_t(unsigned(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(x, equals)))) << i;
+		m.semicolons|= std::uint64_t(unsigned(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(x, semicolon)))) << i;
+		m.escapes|= std::uint64_t(unsigned(_mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(x, pct), _mm_cmpeq_epi8(x, plus))))) << i;
+	}
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const unsigned char* p, blockmasks& m)
+{
+	const __m256i equals = _mm256_set1_epi8('=');
+	const __m256i semicolon = _mm256_set1_epi8(';');
+	const __m256i pct = _mm256_set1_epi8('%');
+	const __m256i plus = _mm256_set1_epi8('+');
+
+	m.equals = m.semicolons = m.escapes = 0;
+	for (int i = 0; i != 64; i+= 32)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		m.equals|= std::uint64_t(std::uint32_t(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, equals)))) << i;
+		m.semicolons|= std::uint64_t(std::uint32_t(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, semicolon)))) << i;
+		m.escapes|= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_cmpeq_epi8(x, pct),
+				_mm256_cmpeq_epi8(x, plus))))) << i;
+	}
+}
+
+#endif // CGIXX_X86_SIMD
+
+typedef void (*classifyfunc)(const unsigned char*, blockmasks&);
+
+classifyfunc selectclassifier()
+{
+#ifdef CGIXX_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return classify_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return classify_sse2;
+#endif
+	return classify_scalar;
+}
+
+inline unsigned trailingzeros(std::uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	unsigned n = 0;
+	while (!(x & 1)) {
+		x>>= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+} // end anonymous namespace
+
+
+/*
+ * Classify a block with a given variant.  Returns false on success, or
+ * true if the variant is not available.
+ */
+bool classifywith(codecvariant variant, const unsigned char* p,
+	blockmasks& m)
+{
+	classifyfunc classify = 0;
+	switch (variant)
+	{
+	case codec_variant_scalar:
+		classify = classify_scalar;
+		break;
+#ifdef CGIXX_X86_SIMD
+	case codec_variant_sse2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2"))
+			classify = classify_sse2;
+		break;
+	case codec_variant_avx2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			classify = classify_avx2;
+		break;
+#endif
+	default:
+		break;
+	}
+	if (!classify)
+		return true;
+	classify(p, m);
+	return false;
+}
+
+
+/*
+ * Classify the 64 bytes at offset b.  The last block is copied into a
+ * zeroed buffer, which matches nothing, so no read passes the end.
+ *
+ */
+void cookiescanner::load(std::size_t b)
+{
+	static const classifyfunc classify = selectclassifier();
+	const unsigned char* p =
+		reinterpret_cast<const unsigned char*>(text.data()) + b;
+	unsigned char tail[64];
+	blockmasks m;
+
+	if (text.length() - b < 64) {
+		std::memset(tail, 0, sizeof(tail));
+		std::memcpy(tail, p, text.length() - b);
+		p = tail;
+	}
+	classify(p, m);
+	equals = m.equals;
+	semicolons = m.semicolons;
+	escapes = m.escapes;
+	base = b;
+}
+
+
+/*
+ * Find the next delimiter.  The scan only moves forward, so only the
+ * block being scanned is kept.
+ *
+ */
+std::size_t cookiescanner::find(bool semicolon, std::size_t from,
+	bool& escaped)
+{
+	while (from < text.length())
+	{
+		std::size_t b = from & ~std::size_t(63);
+		if (b != base)
+			load(b);
+		std::uint64_t live = ~std::uint64_t(0) << (from - b);
+		std::uint64_t hit = (semicolon ? semicolons : equals) & live;
+		if (hit) {
+			unsigned n = trailingzeros(hit);
+			if (escapes & live & ((std::uint64_t(1) << n) - 1))
+				escaped = true;
+			return b + n;
+		}
+		if (escapes & live)
+			escaped = true;
+		from = b + 64;
+	}
+	return text.length();
+}
+
+
+/*
+ * Get the next name=value pair.  Input after the last '=' is ignored.
+ *
+ */
+bool cookiescanner::next(token& t)
+{
+	std::size_t len = text.length();
+	if (pos >= len)
+		return true;
+	t.nameescaped = t.valueescaped = false;
+	std::size_t eq = find(false, pos, t.nameescaped);
+	if (eq == len) {
+		pos = len;
+		return true;
+	}
+	std::size_t semi = find(true, eq + 1, t.valueescaped);
+	t.name = text.substr(pos, eq - pos);
+	t.value = text.substr(eq + 1, semi - eq - 1);
+	pos = semi + 1;
+	while (pos < len && std::isspace(static_cast<unsigned char>(text[pos])))
+		++pos;
+	return false;
+}
+
+} // end namespace cgixx
@@ -0,0 +1,116 @@
+/*
+ * cookiescan.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_cookiescan_h
+#define __cgixx_cookiescan_h
+
+#include "urlcodec.h"
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace cgixx {
+
+/*
+ * Bit masks of the bytes of a 64 byte block that are '=', ';', and '%'
+ * or '+'.  Bit i is byte i.
+ */
+struct blockmasks {
+	std::uint64_t equals;
+	std::uint64_t semicolons;
+	std::uint64_t escapes;
+};
+
+/*
+ * Classify the 64 bytes at p with a given variant, so that tests can check
+ * that every variant gives the same masks.  Returns false on success, or
+ * true if the variant is not compiled in or not supported by this CPU.
+ */
+bool classifywith(codecvariant variant, const unsigned char* p,
+	blockmasks& m);
+
+/*
+ * cookiescanner splits a Cookie header into its name=value pairs without
+ * copying it.  The header is classified 64 bytes at a time into bit
+ * masks of '=', ';' and the bytes that need url-decoding ('%' and '+'),
+ * with SSE2 or AVX2 when the CPU supports them, so delimiters are found
+ * by scanning bits instead of bytes, and each token records whether it
+ * needs decoding at all.
+ *
+ * Tokens are found exactly as parsecookies always has: a name runs to
+ * the next '=', even across a ';', its value runs to the next ';', and
+ * white space after a ';' is skipped.
+ */
+class cookiescanner {
+public:
+	struct token {
+		std::string_view name;
+		std::string_view value;
+		bool nameescaped;	// name contains '%' or '+'
+		bool valueescaped;	// value contains '%' or '+'
+	};
+
+	explicit cookiescanner(std::string_view header)
+		: text(header), pos(0), base(npos), equals(0), semicolons(0),
+		escapes(0) {}
+
+	// Get the next cookie as sent.  Returns false on success, or true at
+	// the end of the header.
+	bool next(token& t);
+
+private:
+	static const std::size_t npos = std::size_t(-1);
+
+	// Find the first '=' (or ';') at or after from, or the end of the
+	// header, setting escaped if a byte before it needs decoding.
+	std::size_t find(bool semicolon, std::size_t from, bool& escaped);
+
+	// Classify the block starting at offset b.
+	void load(std::size_t b);
+
+	std::string_view text;
+	std::size_t pos;		// start of the next token
+	std::size_t base;		// offset of the classified block
+	std::uint64_t equals;		// masks of the classified block
+	std::uint64_t semicolons;
+	std::uint64_t escapes;
+};
+
+} // end namespace cgixx
+
+#endif // __cgixx_cookiescan_h
@@ -0,0 +1,686 @@
+/*
+ * fcgi.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "compat.h"
+
+#include <cgixx/fcgi.h>
+#include <streambuf>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace cgixx {
+
+namespace {
+
+// Definitions from the FastCGI Specification, version 1.
+const unsigned char FCGI_VERSION_1 = 1;
+const std::size_t FCGI_HEADER_LEN = 8;
+const std::size_t FCGI_MAX_CONTENT = 65535;
+
+// Largest FCGI_PARAMS stream accepted for a request.
+const std::size_t maxparamstream = 1 << 20;
+
+enum {
+	FCGI_BEGIN_REQUEST = 1,
+	FCGI_ABORT_REQUEST,
+	FCGI_END_REQUEST,
+	FCGI_PARAMS,
+	FCGI_STDIN,
+	FCGI_STDOUT,
+	FCGI_STDERR,
+	FCGI_DATA,
+	FCGI_GET_VALUES,
+	FCGI_GET_VALUES_RESULT,
+	FCGI_UNKNOWN_TYPE
+};
+
+enum {
+	FCGI_REQUEST_COMPLETE = 0,
+	FCGI_CANT_MPX_CONN,
+	FCGI_OVERLOADED,
+	FCGI_UNKNOWN_ROLE
+};
+
+const unsigned FCGI_RESPONDER = 1;
+const unsigned char FCGI_KEEP_CONN = 1;
+
+/*
+ * Read exactly len bytes from fd.  Returns true on error or end of file.
+ */
+bool readall(int fd, char* buf, std::size_t len)
+{
+	while (len) {
+		ssize_t x = ::read(fd, buf, len);
+		if (x > 0) {
+			buf+= x;
+			len-= x;
+		} else if (x == 0 || errno != EINTR)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Write exactly len bytes to fd.  Returns true on error.
+ */
+bool writeall(int fd, const char* buf, std::size_t len)
+{
+	while (len) {
+#ifdef MSG_NOSIGNAL
+		ssize_t x = ::send(fd, buf, len, MSG_NOSIGNAL);
+#else
+		ssize_t x = ::write(fd, buf, len);
+#endif
+		if (x > 0) {
+			buf+= x;
+			len-= x;
+		} else if (x == 0 || errno != EINTR)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Fill in a record header, returning the number of padding bytes that
+ * must follow the content.
+ */
+std::size_t makeheader(char* hdr, unsigned char type, unsigned reqid,
+	std::size_t clen)
+{
+	std::size_t plen = (8 - clen % 8) % 8;
+	hdr[0] = FCGI_VERSION_1;
+	hdr[1] = type;
+	hdr[2] = (reqid >> 8) & 0xff;
+	hdr[3] = reqid & 0xff;
+	hdr[4] = (clen >> 8) & 0xff;
+	hdr[5] = clen & 0xff;
+	hdr[6] = plen;
+	hdr[7] = 0;
+	return plen;
+}
+
+/*
+ * Write a single record.  Returns true on error.
+ */
+bool writerecord(int fd, unsigned char type, unsigned reqid,
+	const std::string& content)
+{
+	std::string rec(FCGI_HEADER_LEN, '\0');
+	std::size_t plen = makeheader(&rec[0], type, reqid, content.length());
+	rec+= content;
+	rec.append(plen, '\0');
+	return writeall(fd, rec.data(), rec.length());
+}
+
+/*
+ * Write an FCGI_END_REQUEST record.  Returns true on error.
+ */
+bool endrecord(int fd, unsigned reqid, unsigned appstatus,
+	unsigned char protocolstatus)
+{
+	std::string body(8, '\0');
+	body[0] = (appstatus >> 24) & 0xff;
+	body[1] = (appstatus >> 16) & 0xff;
+	body[2] = (appstatus >> 8) & 0xff;
+	body[3] = appstatus & 0xff;
+	body[4] = protocolstatus;
+	return writerecord(fd, FCGI_END_REQUEST, reqid, body);
+}
+
+/*
+ * Read a name or value length from a name-value pair stream.  Returns
+ * true if the data is truncated.
+ */
+bool readlength(const std::string& data, std::size_t& pos, std::size_t& len)
+{
+	if (pos >= data.length())
+		return true;
+	unsigned char c = data[pos];
+	if (c < 0x80) {
+		len = c;
+		++pos;
+		return false;
+	}
+	if (pos + 4 > data.length())
+		return true;
+	len = ((c & 0x7f) << 24) | ((unsigned char)data[pos+1] << 16) |
+		((unsigned char)data[pos+2] << 8) | (unsigned char)data[pos+3];
+	pos+= 4;
+	return false;
+}
+
+/*
+ * Parse a stream of name-value pairs.  Returns true on malformed data.
+ */
+bool parsepairs(const std::string& data, cgi::environment& env)
+{
+	std::size_t pos = 0, namelen, valuelen;
+	while (pos < data.length()) {
+		if (readlength(data, pos, namelen) || readlength(data, pos, valuelen))
+			return true;
+		if (namelen > data.length() - pos ||
+			valuelen > data.length() - pos - namelen)
+			return true;
+		env[data.substr(pos, namelen)] = data.substr(pos + namelen, valuelen);
+		pos+= namelen + valuelen;
+	}
+	return false;
+}
+
+/*
+ * Append a name-value pair to a stream.  Only short names and values are
+ * needed for management records.
+ */
+void addpair(std::string& data, const std::string& name,
+	const std::string& value)
+{
+	data+= static_cast<char>(name.length());
+	data+= static_cast<char>(value.length());
+	data+= name;
+	data+= value;
+}
+
+/*
+ * Answer a request that is too large with an error status, without
+ * reading the rest of it.  Returns true, since the connection must then
+ * be closed.
+ */
+bool reject(int fd, unsigned reqid, const char* status)
+{
+	std::string text("Status: ");
+	text+= status;
+	text+= "\r\nContent-type: text/plain\r\n\r\n";
+	text+= status;
+	text+= "\n";
+	if (!writerecord(fd, FCGI_STDOUT, reqid, text) &&
+		!writerecord(fd, FCGI_STDOUT, reqid, std::string()))
+		endrecord(fd, reqid, 0, FCGI_REQUEST_COMPLETE);
+	return true;
+}
+
+} // end anonymous namespace
+
+
+/*
+ * Stream buffer that sends its contents as FastCGI stream records of a
+ * single type.  Room for the record header is kept in front of the put
+ * area so each record goes out with a single write.
+ */
+class fcgi_streambuf : public std::streambuf {
+public:
+	explicit fcgi_streambuf(unsigned char t) : fd(-1), reqid(0), type(t),
+		written(false)
+	{
+		setp(buf + FCGI_HEADER_LEN, buf + FCGI_HEADER_LEN + bufsize);
+	}
+
+	void open(int f, unsigned id)
+	{
+		fd = f;
+		reqid = id;
+		written = false;
+		setp(buf + FCGI_HEADER_LEN, buf + FCGI_HEADER_LEN + bufsize);
+	}
+
+	// Flush and terminate the stream.  Returns true on error.
+	bool close()
+	{
+		bool failed = flushbuf();
+		if (!failed && (type == FCGI_STDOUT || written))
+			failed = writerecord(fd, type, reqid, std::string());
+		fd = -1;
+		return failed;
+	}
+
+protected:
+	int_type overflow(int_type c)
+	{
+		if (flushbuf())
+			return traits_type::eof();
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int sync()
+	{
+		return flushbuf() ? -1 : 0;
+	}
+
+private:
+	enum { bufsize = 8192 };
+
+	// Send the buffered data as one record.  Returns true on error.
+	bool flushbuf()
+	{
+		std::size_t clen = pptr() - pbase();
+		if (!clen)
+			return false;
+		if (fd < 0)
+			return true;
+		std::size_t plen = makeheader(buf, type, reqid, clen);
+		std::memset(pptr(), 0, plen);
+		setp(buf + FCGI_HEADER_LEN, buf + FCGI_HEADER_LEN + bufsize);
+		written = true;
+		return writeall(fd, buf, FCGI_HEADER_LEN + clen + plen);
+	}
+
+	int fd;
+	unsigned reqid;
+	unsigned char type;
+	bool written;
+	char buf[FCGI_HEADER_LEN + bufsize + 8];
+};
+
+
+struct fcgi_server_impl {
+	fcgi_server_impl(int fd) : listenfd(fd), conn(-1), current(0) {}
+
+	bool readrequest(fcgi_request_impl& req, cgi::environment& env,
+		std::string& input);
+	bool management(unsigned char type, const std::string& content);
+	void closeconn();
+
+	int listenfd;
+	int conn;
+	fcgi_request_impl* current;
+	cgioptions opts;
+};
+
+
+struct fcgi_request_impl {
+	fcgi_request_impl() : c(0), server(0), reqid(0), keepconn(false),
+		active(false), outbuf(FCGI_STDOUT), errbuf(FCGI_STDERR),
+		outstream(&outbuf), errstream(&errbuf) {}
+
+	void end(unsigned appstatus);
+
+	cgi* c;
+	fcgi_server_impl* server;
+	unsigned reqid;
+	bool keepconn;
+	bool active;
+	fcgi_streambuf outbuf;
+	fcgi_streambuf errbuf;
+	std::ostream outstream;
+	std::ostream errstream;
+};
+
+
+/*
+ * Flush the output streams and send FCGI_END_REQUEST.
+ */
+void fcgi_request_impl::end(unsigned appstatus)
+{
+	if (!active)
+		return;
+	active = false;
+	outstream.flush();
+	errstream.flush();
+	bool failed = outbuf.close();
+	failed = errbuf.close() || failed;
+	if (!server)
+		return;
+	if (!failed)
+		failed = endrecord(server->conn, reqid, appstatus,
+			FCGI_REQUEST_COMPLETE);
+	if (failed || !keepconn)
+		server->closeconn();
+	server->current = 0;
+	server = 0;
+}
+
+
+/*
+ * Close the current connection to the web server.
+ */
+void fcgi_server_impl::closeconn()
+{
+	if (conn >= 0)
+		::close(conn);
+	conn = -1;
+}
+
+
+/*
+ * Answer a management record (request id 0).  Returns true on error.
+ */
+bool fcgi_server_impl::management(unsigned char type,
+	const std::string& content)
+{
+	if (type == FCGI_GET_VALUES) {
+		cgi::environment query;
+		if (parsepairs(content, query))
+			return true;
+		std::string result;
+		cgi::environment::const_iterator it(query.begin()),
+			end(query.end());
+		for (; it != end; ++it) {
+			if (it->first == "FCGI_MAX_CONNS")
+				addpair(result, it->first, "1");
+			else if (it->first == "FCGI_MAX_REQS")
+				addpair(result, it->first, "1");
+			else if (it->first == "FCGI_MPXS_CONNS")
+				addpair(result, it->first, "0");
+		}
+		return writerecord(conn, FCGI_GET_VALUES_RESULT, 0, result);
+	}
+	std::string body(8, '\0');
+	body[0] = type;
+	return writerecord(conn, FCGI_UNKNOWN_TYPE, 0, body);
+}
+
+
+/*
+ * Read records from the current connection until a complete responder
+ * request has arrived.  A request whose parameters exceed maxparamstream,
+ * or whose body exceeds the maxbody limit, is answered with an error as
+ * soon as that is known.  Returns true if the connection must be closed.
+ */
+bool fcgi_server_impl::readrequest(fcgi_request_impl& req,
+	cgi::environment& env, std::string& input)
+{
+	std::string params, content;
+	bool paramsdone = false, stdindone = false;
+	char hdr[FCGI_HEADER_LEN], padding[256];
+
+	req.reqid = 0;
+	input.erase();
+	for (;;) {
+		if (readall(conn, hdr, FCGI_HEADER_LEN))
+			return true;
+		if (hdr[0] != FCGI_VERSION_1)
+			return true;
+		unsigned char type = hdr[1];
+		unsigned id = ((unsigned char)hdr[2] << 8) | (unsigned char)hdr[3];
+		std::size_t clen = ((unsigned char)hdr[4] << 8) | (unsigned char)hdr[5];
+		std::size_t plen = (unsigned char)hdr[6];
+		content.resize(clen);
+		if (clen && readall(conn, &content[0], clen))
+			return true;
+		if (plen && readall(conn, padding, plen))
+			return true;
+
+		if (id == 0) {
+			if (management(type, content))
+				return true;
+			continue;
+		}
+
+		switch (type) {
+		case FCGI_BEGIN_REQUEST:
+			if (clen < 8)
+				return true;
+			if (req.reqid) {
+				// Only one request at a time on a connection.
+				if (endrecord(conn, id, 0, FCGI_CANT_MPX_CONN))
+					return true;
+				break;
+			}
+			if ((((unsigned char)content[0] << 8) |
+				(unsigned char)content[1]) != FCGI_RESPONDER)
+			{
+				if (endrecord(conn, id, 0, FCGI_UNKNOWN_ROLE))
+					return true;
+				if (!(content[2] & FCGI_KEEP_CONN))
+					return true;
+				break;
+			}
+			req.reqid = id;
+			req.keepconn = (content[2] & FCGI_KEEP_CONN) != 0;
+			break;
+		case FCGI_ABORT_REQUEST:
+			if (id != req.reqid)
+				break;
+			if (endrecord(conn, id, 0, FCGI_REQUEST_COMPLETE) || !req.keepconn)
+				return true;
+			req.reqid = 0;
+			params.erase();
+			input.erase();
+			paramsdone = stdindone = false;
+			break;
+		case FCGI_PARAMS:
+			if (id != req.reqid || paramsdone)
+				break;
+			if (params.length() + clen > maxparamstream)
+				return reject(conn, id, "431 Request Header Fields Too Large");
+			if (clen)
+				params+= content;
+			else
+				paramsdone = true;
+			break;
+		case FCGI_STDIN:
+			if (id != req.reqid || stdindone)
+				break;
+			// Check the limit as the body arrives, not once it is stored.
+			if (opts.limits.maxbody &&
+				input.length() + clen > opts.limits.maxbody)
+				return reject(conn, id, "413 Request Entity Too Large");
+			if (clen)
+				input+= content;
+			else
+				stdindone = true;
+			break;
+		default:
+			// FCGI_DATA belongs to the filter role.
+			break;
+		}
+
+		if (req.reqid && paramsdone && stdindone) {
+			env.clear();
+			return parsepairs(params, env);
+		}
+	}
+}
+
+
+/**
+ * Construct an empty request, to be filled in by fcgi_server::accept.
+ */
+fcgi_request::fcgi_request() : imp(new fcgi_request_impl)
+{
+}
+
+
+/**
+ * Destroy *this request, finishing it if necessary.
+ */
+fcgi_request::~fcgi_request()
+{
+	imp->end(0);
+	delete imp->c;
+	delete imp;
+}
+
+
+/**
+ * Get the cgi instance built from the parameters and body of this
+ * request.
+ *
+ * @return	Reference to the cgi instance.
+ */
+cgi& fcgi_request::getcgi()
+{
+	if (!imp->c)
+		throw cgiexception("No FastCGI request is active");
+	return *imp->c;
+}
+
+
+/**
+ * Get the output stream for this request.  Data written to the stream
+ * is sent to the web server in FCGI_STDOUT records.
+ *
+ * @return	Reference to the output stream.
+ */
+std::ostream& fcgi_request::out()
+{
+	return imp->outstream;
+}
+
+
+/**
+ * Get the error stream for this request.  Data written to the stream
+ * is sent to the web server in FCGI_STDERR records.
+ *
+ * @return	Reference to the error stream.
+ */
+std::ostream& fcgi_request::err()
+{
+	return imp->errstream;
+}
+
+
+/**
+ * Complete this request.  All output is flushed and the web server is
+ * told that the request has ended.  The next call to fcgi_server::accept
+ * also finishes an unfinished request.
+ *
+ * @param	appstatus	The application exit status to report.
+ * @return	nothing
+ */
+void fcgi_request::finish(unsigned appstatus)
+{
+	imp->end(appstatus);
+}
+
+
+/**
+ * Construct a FastCGI server.  The web server normally starts a FastCGI
+ * application with the listening socket on descriptor 0.
+ *
+ * @param	listenfd	The listening socket.
+ */
+fcgi_server::fcgi_server(int listenfd) : imp(new fcgi_server_impl(listenfd))
+{
+}
+
+
+/**
+ * Destroy *this server, finishing any active request and closing the
+ * current connection.  The listening socket is not closed.
+ */
+fcgi_server::~fcgi_server()
+{
+	if (imp->current)
+		imp->current->end(0);
+	imp->closeconn();
+	delete imp;
+}
+
+
+/**
+ * Wait for the next request and store it in req.  Any request still
+ * active in req is finished first.  A cgiexception thrown while building
+ * the cgi instance for the request leaves the request active, so an
+ * error response can still be written to out() before finish().
+ *
+ * @param	req		Reference to request to receive the next request.
+ * @return	false on success;
+ * @return	true when no more requests can be accepted.
+ */
+bool fcgi_server::accept(fcgi_request& req)
+{
+	fcgi_request_impl& r = *req.imp;
+	r.end(0);
+	delete r.c;
+	r.c = 0;
+
+	cgi::environment env;
+	std::string input;
+	for (;;) {
+		if (imp->conn < 0) {
+			int fd = ::accept(imp->listenfd, 0, 0);
+			if (fd < 0) {
+				if (errno == EINTR)
+					continue;
+				return true;
+			}
+			imp->conn = fd;
+		}
+		if (!imp->readrequest(r, env, input))
+			break;
+		imp->closeconn();
+	}
+
+	r.server = imp;
+	r.active = true;
+	imp->current = &r;
+	r.outbuf.open(imp->conn, r.reqid);
+	r.errbuf.open(imp->conn, r.reqid);
+	r.outstream.clear();
+	r.errstream.clear();
+	r.c = new cgi(env, input, imp->opts);
+	return false;
+}
+
+
+/**
+ * Set the options used to build the cgi instance of each request.  The
+ * maxbody limit is also checked as each body is received, so a request
+ * that exceeds it is answered with status 413 and never buffered whole.
+ *
+ * @param	opts	Options for processing requests.
+ * @return	nothing
+ */
+void fcgi_server::setoptions(const cgioptions& opts)
+{
+	imp->opts = opts;
+}
+
+
+/**
+ * Check whether the process was started as a FastCGI application, that
+ * is whether listenfd is a socket that is not connected.
+ *
+ * @param	listenfd	The descriptor to check.
+ * @return	true if listenfd is a FastCGI listening socket.
+ */
+bool fcgi_server::isfastcgi(int listenfd)
+{
+	struct sockaddr sa;
+	socklen_t len = sizeof(sa);
+	return ::getpeername(listenfd, &sa, &len) == -1 && errno == ENOTCONN;
+}
+
+} // end namespace cgixx
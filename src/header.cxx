@@ -37,37 +37,116 @@
 
 #include "compat.h"
 
-#include "timedefs.inl"
+#include "httpdate.h"
+#include "pmralloc.h"
 #include <cgixx/header.h>
 #include <cgixx/cookie.h>
 #include <vector>
+#include <memory_resource>
+#include <string_view>
+#include <charconv>
 #include <cstdio>
-#include <cctype>
+#include <cstring>
 #include <ctime>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+#endif
 
 namespace cgixx {
 
 struct header_impl
 {
-	std::string httpver;
-	std::string status;
+	std::pmr::memory_resource* resource;
+
+	std::pmr::string httpver;
+	std::pmr::string status;
 	unsigned content_length;
-	std::string content_type;
-	std::string expire;
-	std::string location;
+	bool haslength;	// send content_length even if it is 0
+	std::pmr::string content_type;
+	std::pmr::string expire;
+	std::pmr::string location;
 
-	std::vector< std::string > extra_headers;
+	std::pmr::vector< std::pmr::string > extra_headers;
 
-	header_impl() : content_length(0),
-		content_type("text/html") {}
+	explicit header_impl(std::pmr::memory_resource* r) : resource(r),
+		httpver(r), status(r), content_length(0), haslength(false),
+		content_type("text/html", r),
+		expire(r), location(r), extra_headers(r) {}
+};
+
+struct frozenheader_impl
+{
+	std::pmr::memory_resource* resource;
+
+	// The formatted header, without the Location and Content-length
+	// lines, and with the date it was frozen at in the Date slot.
+	std::pmr::string text;
+	std::size_t locationat;
+	std::size_t dateat;
+	std::size_t lengthat;
+	std::size_t cookieat;
+
+	// The Location and Content-length of the header that was frozen.
+	std::pmr::string location;
+	unsigned content_length;
+	bool haslength;
+
+	explicit frozenheader_impl(std::pmr::memory_resource* r) : resource(r),
+		text(r), locationat(0), dateat(0), lengthat(0), cookieat(0),
+		location(r), content_length(0), haslength(false) {}
+
+	// Get the Content-length to send for a patch.  Returns false if there
+	// is none.
+	bool length(const headerpatch& patch, unsigned& value) const
+	{
+		bool patched = patch.length || patch.haslength;
+		value = patched ? patch.length : content_length;
+		return patched ? value || patch.haslength : value || haslength;
+	}
 };
 
 /**
  * Construct a header object.
  */
 header::header()
+	: imp(makeimpl<header_impl>(storage, std::pmr::get_default_resource(),
+		std::pmr::get_default_resource()))
+{
+}
+
+/**
+ * Construct a header object whose memory comes from resource.
+ *
+ * @param	resource	The memory resource, which must outlive *this
+ *						header, or 0 for the default resource.
+ */
+header::header(std::pmr::memory_resource* resource)
+	: imp(makeimpl<header_impl>(storage, resourceor(resource),
+		resourceor(resource)))
 {
-	imp = new header_impl;
+}
+
+/**
+ * Construct a header object by moving the contents of another, which
+ * may then only be assigned to or destroyed.  No memory is allocated.
+ *
+ * @param	other	The header to move from.
+ */
+header::header(header&& other) noexcept : imp(other.imp)
+{
+	if (isinline(other.storage, other.imp))
+		imp = new (storage) header_impl(std::move(*other.imp));
+	else
+		other.imp = 0;
 }
 
 /**
@@ -75,94 +154,240 @@ header::header()
  */
 header::~header()
 {
-	delete imp;
+	destroyimpl(storage, imp);
 }
 
-
 /**
- * Get the formatted CGI HTTP header to send to the client.  The
- * default header will be
+ * Replace the contents of *this header by moving those of another,
+ * which may then only be assigned to or destroyed.
  *
- * 400 OK
- * Content-type: text/html
- *
- * unless modified by other header methods.  The web server may modify
- * or expand on these headers unless a specific status code has been
- * specified (e.g. through redirect method).
- *
- * @return	The header string.
+ * @param	other	The header to move from.
+ * @return	*this
  */
-std::string header::get() const
+header& header::operator=(header&& other) noexcept
 {
-	std::string hdr;
+	if (this != &other)
+	{
+		destroyimpl(storage, imp);
+		imp = other.imp;
+		if (isinline(other.storage, other.imp))
+			imp = new (storage) header_impl(std::move(*other.imp));
+		else
+			other.imp = 0;
+	}
+	return *this;
+}
+
 
-	if (!imp->httpver.empty())
+namespace {
+
+/*
+ * The parts of a header that a frozenheader fills in per response.
+ */
+enum headerslot {
+	slot_none,
+	slot_location,
+	slot_date,
+	slot_length,
+	slot_cookies
+};
+
+/*
+ * Pass each piece of the formatted header, in order, to piece along with
+ * the slot it belongs to.  An empty piece marks where each slot starts.
+ * get and write join the pieces or send them with writev, so both
+ * produce the same bytes, and frozenheader records where the slots are.
+ * The content length is formatted into number, which must outlive the
+ * pieces.
+ */
+template <class F>
+void emit(const header_impl& h, char (&number)[32], F piece)
+{
+	if (!h.httpver.empty())
 	{
-		hdr+= imp->httpver;
-		hdr+= "\r\n";
+		piece(h.httpver, slot_none);
+		piece("\r\n", slot_none);
 	}
 
-	if (!imp->status.empty())
+	if (!h.status.empty())
 	{
-		hdr+= "Status: ";
-		hdr+= imp->status;
-		hdr+= "\r\n";
+		piece("Status: ", slot_none);
+		piece(h.status, slot_none);
+		piece("\r\n", slot_none);
 	}
 
-	if (!imp->location.empty())
+	piece(std::string_view(), slot_location);
+	if (!h.location.empty())
 	{
-		hdr+= "Location: ";
-		hdr+= imp->location;
-		hdr+= "\r\n";
+		piece("Location: ", slot_location);
+		piece(h.location, slot_location);
+		piece("\r\n", slot_location);
 	}
 
-	if (!imp->content_type.empty())
+	if (!h.content_type.empty())
 	{
 		// Build content type (e.g. "Content-type: text/html")
-		hdr+= "Content-type: ";
-		hdr+= imp->content_type;
-		hdr+= "\r\n";
+		piece("Content-type: ", slot_none);
+		piece(h.content_type, slot_none);
+		piece("\r\n", slot_none);
 	}
 
-	std::time_t timer = std::time(NULL);
-	struct std::tm* ts = std::gmtime(&timer);
-	char buf[72];
-	std::sprintf(buf, "%s, %02u-%s-%04u %02u:%02u:%02u GMT",
-		weekday[ts->tm_wday], ts->tm_mday, month[ts->tm_mon],
-		ts->tm_year + 1900, ts->tm_hour, ts->tm_min, ts->tm_sec);
-	hdr+= "Date: ";
-	hdr+= buf;
-	hdr+= "\r\n";
-
-	if (!imp->expire.empty())
+	piece("Date: ", slot_none);
+	piece(std::string_view(), slot_date);
+	piece(httpdatenow(), slot_date);
+	piece("\r\n", slot_none);
+
+	if (!h.expire.empty())
 	{
-		hdr+= "Expires: ";
-		hdr+= imp->expire;
-		hdr+= "\r\n";
+		piece("Expires: ", slot_none);
+		piece(h.expire, slot_none);
+		piece("\r\n", slot_none);
 	}
 
-	if (imp->content_length)
+	piece(std::string_view(), slot_length);
+	if (h.content_length || h.haslength)
 	{
-		char buf[32];
-		std::sprintf(buf, "%u", imp->content_length);
-		hdr+= "Content-length: ";
-		hdr+= buf;
-		hdr+= "\r\n";
+		int len = std::sprintf(number, "%u", h.content_length);
+		piece("Content-length: ", slot_length);
+		piece(std::string_view(number, len), slot_length);
+		piece("\r\n", slot_length);
 	}
 
-	std::vector< std::string >::const_iterator it(imp->extra_headers.begin()),
-		end(imp->extra_headers.end());
+	std::pmr::vector< std::pmr::string >::const_iterator
+		it(h.extra_headers.begin()), end(h.extra_headers.end());
 	for (; it != end; ++it)
 	{
-		hdr+= *it;
-		hdr+= "\r\n";
+		piece(*it, slot_none);
+		piece("\r\n", slot_none);
+	}
+
+	piece(std::string_view(), slot_cookies);
+	piece("\r\n", slot_none);
+}
+
+#ifdef _WIN32
+/*
+ * Write all of a buffer, resuming after partial writes.
+ */
+bool writeall(int fd, const char* p, std::size_t left)
+{
+	while (left)
+	{
+		int n = ::_write(fd, p, unsigned(left));
+		if (n <= 0)
+			return true;
+		p+= n;
+		left-= n;
+	}
+	return false;
+}
+#else
+/*
+ * Add a piece to an iovec array, skipping empty pieces.
+ */
+void addiov(std::pmr::vector<struct iovec>& iov, std::string_view text)
+{
+	if (!text.empty())
+	{
+		struct iovec v;
+		v.iov_base = const_cast<char*>(text.data());
+		v.iov_len = text.length();
+		iov.push_back(v);
+	}
+}
+
+/*
+ * Write all of an iovec array, resuming after partial writes and
+ * signals, and in batches of at most IOV_MAX.
+ */
+bool writeallv(int fd, struct iovec* iov, std::size_t count)
+{
+	while (count)
+	{
+		ssize_t n = ::writev(fd, iov, int(count < IOV_MAX ? count : IOV_MAX));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return true;
+		while (count && std::size_t(n) >= iov->iov_len)
+		{
+			n-= iov->iov_len;
+			++iov;
+			--count;
+		}
+		if (count)
+		{
+			iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+			iov->iov_len-= n;
+		}
 	}
+	return false;
+}
+#endif
+
+} // end anonymous namespace
 
-	hdr+= "\r\n";
+
+/**
+ * Get the formatted CGI HTTP header to send to the client.  The
+ * default header will be
+ *
+ * 400 OK
+ * Content-type: text/html
+ *
+ * unless modified by other header methods.  The web server may modify
+ * or expand on these headers unless a specific status code has been
+ * specified (e.g. through redirect method).
+ *
+ * @return	The header string.
+ */
+std::string header::get() const
+{
+	std::string hdr;
+	char number[32];
+	emit(*imp, number, [&hdr](std::string_view text, headerslot) {
+		hdr+= text;
+	});
 	return hdr;
 }
 
 
+/**
+ * Write the formatted header, as returned by get, and optionally the
+ * body of the response to a file descriptor such as STDOUT_FILENO.  The
+ * pieces of the header are sent in place with a single writev, without
+ * first being joined into a string.  Anything buffered in std::cout or
+ * stdout must be flushed first.
+ *
+ * @param	fd			Descriptor to write to.
+ * @param	body		Body to send after the header, or 0.
+ * @param	length		Length of the body.
+ * @return	false on success; true if a write failed, with errno set.
+ */
+bool header::write(int fd, const char* body, std::size_t length) const
+{
+#ifdef _WIN32
+	std::string out(get());
+	out.append(body, length);
+	return writeall(fd, out.data(), out.length());
+#else
+	// Room for a typical header without touching the heap.
+	alignas(struct iovec) unsigned char local[48 * sizeof(struct iovec)];
+	std::pmr::monotonic_buffer_resource arena(local, sizeof(local));
+	std::pmr::vector<struct iovec> iov(&arena);
+	iov.reserve(sizeof(local) / sizeof(struct iovec));
+
+	char number[32];
+	emit(*imp, number, [&iov](std::string_view text, headerslot) {
+		addiov(iov, text);
+	});
+	if (body)
+		addiov(iov, std::string_view(body, length));
+	return writeallv(fd, iov.data(), iov.size());
+#endif
+}
+
+
 /**
  * Set the status code to be returned to the client.  Manually setting
  * the status code will override the web server's ability to alter
@@ -253,14 +478,18 @@ void header::setstatus(unsigned status, const std::string& description)
 
 
 /**
- * Set the content length to be sent to the client.
+ * Set the content length to be sent to the client.  A length of 0 is
+ * not sent unless always is set.
  *
  * @param	length		The content length.
+ * @param	always		Send the length even if it is 0, as for an
+ *						empty body.
  * @return	nothing
  */
-void header::setlength(unsigned length)
+void header::setlength(unsigned length, bool always)
 {
 	imp->content_length = length;
+	imp->haslength = always;
 }
 
 
@@ -300,10 +529,9 @@ void header::override(const std::string& httpversion)
  */
 void header::setheader(const std::string& id, const std::string& value)
 {
-	std::string newhead(id);
+	std::pmr::string& newhead = imp->extra_headers.emplace_back(id);
 	newhead+= ": ";
 	newhead+= value;
-	imp->extra_headers.push_back(newhead);
 }
 
 
@@ -327,9 +555,9 @@ void header::redirect(const std::string& location)
  * @param	value	Reference to completed cookie.
  * @return	nothing
  */
-void header::addcookie(cookie& value)
+void header::addcookie(const cookie& value)
 {
-	imp->extra_headers.push_back(value.get());
+	imp->extra_headers.emplace_back(value.get());
 }
 
 
@@ -338,7 +566,7 @@ void header::addcookie(cookie& value)
  *
  * @param	expire		The expire parameter my be either the RFC 850
  *						encoded date of expiration, or an offset string
- *						containing "(-)123(M|H|S|D|W|m|Y)".  I.e. a
+ *						containing "(+|-)123(M|H|S|D|W|m|Y)".  I.e. a
  *						number (negative numbers generally cause the
  *						document to expire immediately) followed by a
  *						time modifier.  M=minute, H=hour, S=second,
@@ -348,63 +576,277 @@ void header::addcookie(cookie& value)
  */
 bool header::setexpire(const std::string& expire)
 {
-	// First, attempt to parse expire.
-	register unsigned pos = 0;
-	bool isneg = false;
-
-	if (expire[0] == '-')
-		++pos;
-	if (std::isdigit(expire[pos]))
+	std::time_t when;
+	if (expireoffset(expire, when))
 	{
-		while (std::isdigit(expire[++pos]))
-			;
-		unsigned duration = std::atoi(expire.substr(0, pos).c_str());
-		switch (expire[pos])
+		imp->expire = expire;
+		return true;
+	}
+	char buf[httpdatelength];
+	imp->expire.assign(buf, formathttpdate(when, buf));
+	return false;
+}
+
+
+/**
+ * Freeze *this header into a frozenheader, which formats the same
+ * header much faster but can no longer be modified.
+ *
+ * @return	The frozen header.
+ */
+frozenheader header::freeze() const
+{
+	return frozenheader(*this);
+}
+
+
+/**
+ * Construct a frozenheader from the current state of a header.  The
+ * Date, Location and Content-length lines are left as slots; Expires
+ * and cookies added to the header are frozen as they are now.  Memory
+ * comes from the resource of the source header.
+ *
+ * @param	source		The header to freeze.
+ */
+frozenheader::frozenheader(const header& source)
+	: imp(newobject<frozenheader_impl>(source.imp->resource,
+		source.imp->resource))
+{
+	frozenheader_impl& f = *imp;
+	f.location = source.imp->location;
+	f.content_length = source.imp->content_length;
+	f.haslength = source.imp->haslength;
+
+	char number[32];
+	emit(*source.imp, number, [&f](std::string_view text, headerslot slot) {
+		if (text.empty())
 		{
-		case 'M':	// minute
-			duration*= 60;
-			break;
-		case 'H':
-			duration*= 3600;
-			break;
-		case 'D':
-		case 'd':
-			duration*= 84600;
-			break;
-		case 'W':
-		case 'w':
-			duration*= 84600*7;
-			break;
-		case 'm':
-			duration*= 84600*30;
-			break;
-		case 'Y':
-		case 'y':
-			duration*= 84600*365;
-			break;
-		case 'S':
-		case 's':
-			break;
-		default:
-			imp->expire = expire;
-			return true;
+			switch (slot)
+			{
+			case slot_location: f.locationat = f.text.length(); break;
+			case slot_date:     f.dateat = f.text.length();     break;
+			case slot_length:   f.lengthat = f.text.length();   break;
+			case slot_cookies:  f.cookieat = f.text.length();   break;
+			default: break;
+			}
 		}
-		std::time_t timer = std::time(NULL);
-        if (isneg)
-            timer-= duration;
-        else
-            timer+= duration;
-		struct std::tm* ts = std::gmtime(&timer);
-		char buf[72];
-		std::sprintf(buf, "%s, %02u-%s-%04u %02u:%02u:%02u GMT",
-			weekday[ts->tm_wday], ts->tm_mday, month[ts->tm_mon],
-			ts->tm_year + 1900, ts->tm_hour, ts->tm_min, ts->tm_sec);
-		imp->expire = buf;
-		return false;
+		else if (slot == slot_none || slot == slot_date)
+			f.text+= text;
+	});
+}
+
+
+/**
+ * Construct a frozenheader by moving the contents of another, which may
+ * then only be destroyed.
+ *
+ * @param	other	The frozenheader to move from.
+ */
+frozenheader::frozenheader(frozenheader&& other) noexcept : imp(other.imp)
+{
+	other.imp = 0;
+}
+
+
+/**
+ * Destroy *this frozenheader.
+ */
+frozenheader::~frozenheader()
+{
+	if (imp)
+		deleteobject(imp->resource, imp);
+}
+
+
+namespace {
+
+/*
+ * Format a content length, returning where its digits start in number.
+ */
+std::string_view formatlength(unsigned length, char (&number)[32])
+{
+	return std::string_view(number,
+		std::to_chars(number, number + sizeof(number), length).ptr - number);
+}
+
+/*
+ * Copy text to out, returning the end of the copy.
+ */
+inline char* put(char* out, std::string_view text)
+{
+	std::memcpy(out, text.data(), text.length());
+	return out + text.length();
+}
+
+} // end anonymous namespace
+
+
+/**
+ * Get the length of the header that copy produces for a patch.
+ *
+ * @param	patch		The per-response parts of the header.
+ * @return	The length in bytes.
+ */
+std::size_t frozenheader::size(const headerpatch& patch) const
+{
+	std::size_t n = imp->text.length();
+	std::string_view location(patch.location.empty() ?
+		std::string_view(imp->location) : patch.location);
+	if (!location.empty())
+		n+= sizeof("Location: \r\n") - 1 + location.length();
+	unsigned length;
+	if (imp->length(patch, length))
+	{
+		char number[32];
+		n+= sizeof("Content-length: \r\n") - 1 +
+			formatlength(length, number).length();
+	}
+	for (std::size_t i = 0; i < patch.cookiecount; ++i)
+		n+= patch.cookies[i].length() + 2;
+	return n;
+}
+
+
+/**
+ * Copy the header for a patch into a buffer.  The frozen text is copied
+ * in blocks, with the current date and the patched lines written in
+ * between.
+ *
+ * @param	out			The buffer, which must hold size(patch) bytes.
+ * @param	patch		The per-response parts of the header.
+ * @return	The number of bytes copied, which is size(patch).
+ */
+std::size_t frozenheader::copy(char* out, const headerpatch& patch) const
+{
+	const frozenheader_impl& f = *imp;
+	std::string_view text(f.text);
+	char* p = out;
+
+	p = put(p, text.substr(0, f.locationat));
+	std::string_view location(patch.location.empty() ?
+		std::string_view(f.location) : patch.location);
+	if (!location.empty())
+	{
+		p = put(p, "Location: ");
+		p = put(p, location);
+		p = put(p, "\r\n");
+	}
+
+	// Copy up to the Content-length slot, then patch in the date.
+	char* base = p - f.locationat;
+	p = put(p, text.substr(f.locationat, f.lengthat - f.locationat));
+	std::memcpy(base + f.dateat, httpdatenow().data(), httpdatelength);
+
+	unsigned length;
+	if (f.length(patch, length))
+	{
+		char number[32];
+		p = put(p, "Content-length: ");
+		p = put(p, formatlength(length, number));
+		p = put(p, "\r\n");
 	}
 
-	imp->expire = expire;
-	return true;
+	p = put(p, text.substr(f.lengthat, f.cookieat - f.lengthat));
+	for (std::size_t i = 0; i < patch.cookiecount; ++i)
+	{
+		p = put(p, patch.cookies[i]);
+		p = put(p, "\r\n");
+	}
+	p = put(p, text.substr(f.cookieat));
+	return p - out;
+}
+
+
+/**
+ * Append the header for a patch to a string.
+ *
+ * @param	out			The string to append to.
+ * @param	patch		The per-response parts of the header.
+ */
+void frozenheader::append(std::string& out, const headerpatch& patch) const
+{
+	std::size_t at = out.length();
+	out.resize(at + size(patch));
+	copy(&out[at], patch);
+}
+
+
+/**
+ * Get the header for a patch.
+ *
+ * @param	patch		The per-response parts of the header.
+ * @return	The header string.
+ */
+std::string frozenheader::get(const headerpatch& patch) const
+{
+	std::string out;
+	append(out, patch);
+	return out;
+}
+
+
+/**
+ * Write the header for a patch, and optionally the body of the response,
+ * to a file descriptor with a single writev.  The frozen text is sent in
+ * place, so nothing is copied.  Anything buffered in std::cout or stdout
+ * must be flushed first.
+ *
+ * @param	fd			Descriptor to write to.
+ * @param	patch		The per-response parts of the header.
+ * @param	body		Body to send after the header, or 0.
+ * @param	length		Length of the body.
+ * @return	false on success; true if a write failed, with errno set.
+ */
+bool frozenheader::write(int fd, const headerpatch& patch, const char* body,
+	std::size_t length) const
+{
+#ifdef _WIN32
+	std::string out(get(patch));
+	out.append(body, length);
+	return writeall(fd, out.data(), out.length());
+#else
+	const frozenheader_impl& f = *imp;
+	std::string_view text(f.text);
+
+	alignas(struct iovec) unsigned char local[32 * sizeof(struct iovec)];
+	std::pmr::monotonic_buffer_resource arena(local, sizeof(local));
+	std::pmr::vector<struct iovec> iov(&arena);
+	iov.reserve(sizeof(local) / sizeof(struct iovec));
+
+	addiov(iov, text.substr(0, f.locationat));
+	std::string_view location(patch.location.empty() ?
+		std::string_view(f.location) : patch.location);
+	if (!location.empty())
+	{
+		addiov(iov, "Location: ");
+		addiov(iov, location);
+		addiov(iov, "\r\n");
+	}
+	addiov(iov, text.substr(f.locationat, f.dateat - f.locationat));
+	addiov(iov, httpdatenow());
+	addiov(iov, text.substr(f.dateat + httpdatelength,
+		f.lengthat - f.dateat - httpdatelength));
+
+	char number[32];
+	unsigned contentlength;
+	if (f.length(patch, contentlength))
+	{
+		addiov(iov, "Content-length: ");
+		addiov(iov, formatlength(contentlength, number));
+		addiov(iov, "\r\n");
+	}
+
+	addiov(iov, text.substr(f.lengthat, f.cookieat - f.lengthat));
+	for (std::size_t i = 0; i < patch.cookiecount; ++i)
+	{
+		addiov(iov, patch.cookies[i]);
+		addiov(iov, "\r\n");
+	}
+	addiov(iov, text.substr(f.cookieat));
+	if (body)
+		addiov(iov, std::string_view(body, length));
+	return writeallv(fd, iov.data(), iov.size());
+#endif
 }
 
 } // end namespace cgixx
@@ -0,0 +1,210 @@
+/*
+ * httpdate.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * HTTP dates for the Date and Expires headers and cookie expiry.  Dates
+ * are converted from time_t arithmetically, without gmtime, so they are
+ * thread safe, and written without sprintf.  The current date is cached
+ * per thread and only formatted again when the second changes.
+ */
+
+#include "httpdate.h"
+#include <cctype>
+
+namespace cgixx {
+
+namespace {
+
+const char weekday[] = "SunMonTueWedThuFriSat";
+const char month[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+// Dates are kept within years 1970 to 9999.
+const long long lasttime = 253402300799LL;
+
+inline char* twodigits(char* out, unsigned n)
+{
+	out[0] = char('0' + n / 10);
+	out[1] = char('0' + n % 10);
+	return out + 2;
+}
+
+inline char* copy3(char* out, const char* in)
+{
+	out[0] = in[0];
+	out[1] = in[1];
+	out[2] = in[2];
+	return out + 3;
+}
+
+struct datecache {
+	datecache() : second(-1), length(0) {}
+
+	std::time_t second;
+	std::size_t length;
+	char text[httpdatelength];
+};
+
+thread_local datecache now;
+
+} // end anonymous namespace
+
+
+/*
+ * Format a date.  The civil date is found from the day number as in
+ * Howard Hinnant's days_from_civil algorithms.
+ *
+ */
+std::size_t formathttpdate(std::time_t t, char* buf)
+{
+	long long time = t < 0 ? 0 : t > lasttime ? lasttime : t;
+	long long days = time / 86400;
+	unsigned secs = unsigned(time % 86400);
+	long long z = days + 719468;
+	long long era = z / 146097;
+	unsigned doe = unsigned(z - era * 146097);
+	unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned mp = (5 * doy + 2) / 153;
+	unsigned day = doy - (153 * mp + 2) / 5 + 1;
+	unsigned mon = mp < 10 ? mp + 2 : mp - 10;	// 0 based
+	unsigned year = unsigned(yoe + era * 400) + (mon < 2);
+
+	char* out = copy3(buf, weekday + 3 * ((days + 4) % 7));
+	*out++ = ',';
+	*out++ = ' ';
+	out = twodigits(out, day);
+	*out++ = '-';
+	out = copy3(out, month + 3 * mon);
+	*out++ = '-';
+	out = twodigits(out, year / 100);
+	out = twodigits(out, year % 100);
+	*out++ = ' ';
+	out = twodigits(out, secs / 3600);
+	*out++ = ':';
+	out = twodigits(out, secs / 60 % 60);
+	*out++ = ':';
+	out = twodigits(out, secs % 60);
+	out = copy3(out, " GM");
+	*out++ = 'T';
+	return out - buf;
+}
+
+
+/*
+ * Get the current date, formatting it only when the second has changed
+ * since the last call on this thread.
+ *
+ */
+std::string_view httpdatenow()
+{
+	std::time_t t = std::time(0);
+	if (t != now.second)
+	{
+		now.length = formathttpdate(t, now.text);
+		now.second = t;
+	}
+	return std::string_view(now.text, now.length);
+}
+
+
+/*
+ * Parse an expire offset.  As always, anything after the unit is
+ * ignored.
+ *
+ */
+bool expireoffset(std::string_view expire, std::time_t& when)
+{
+	std::size_t pos = 0;
+	bool isneg = false;
+	if (pos < expire.length() && (expire[pos] == '-' || expire[pos] == '+'))
+	{
+		isneg = expire[pos] == '-';
+		++pos;
+	}
+	if (pos == expire.length() ||
+		!std::isdigit(static_cast<unsigned char>(expire[pos])))
+		return true;
+
+	// Saturate well beyond the last date.
+	long long count = 0;
+	for (; pos < expire.length() &&
+		std::isdigit(static_cast<unsigned char>(expire[pos])); ++pos)
+		if (count < 100000000)
+			count = count * 10 + (expire[pos] - '0');
+	if (pos == expire.length())
+		return true;
+
+	long long unit;
+	switch (expire[pos])
+	{
+	case 'S':
+	case 's':
+		unit = 1;
+		break;
+	case 'M':	// minute
+		unit = 60;
+		break;
+	case 'H':
+		unit = 3600;
+		break;
+	case 'D':
+	case 'd':
+		unit = 86400;
+		break;
+	case 'W':
+	case 'w':
+		unit = 86400 * 7;
+		break;
+	case 'm':
+		unit = 86400 * 30;
+		break;
+	case 'Y':
+	case 'y':
+		unit = 86400 * 365;
+		break;
+	default:
+		return true;
+	}
+	long long offset = count * unit;
+	long long t = static_cast<long long>(std::time(0)) +
+		(isneg ? -offset : offset);
+	when = static_cast<std::time_t>(t < 0 ? 0 : t > lasttime ? lasttime : t);
+	return false;
+}
+
+} // end namespace cgixx
@@ -0,0 +1,65 @@
+/*
+ * httpdate.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_httpdate_h
+#define __cgixx_httpdate_h
+
+#include <string_view>
+#include <cstddef>
+#include <ctime>
+
+namespace cgixx {
+
+// Longest date written by formathttpdate.
+const std::size_t httpdatelength = 29;
+
+// Write t as "Wdy, DD-Mon-YYYY HH:MM:SS GMT" to buf, which must hold
+// httpdatelength bytes, and return the length.  Thread safe.
+std::size_t formathttpdate(std::time_t t, char* buf);
+
+// The current date, formatted once per second per thread.  The view is
+// valid until the next call on the same thread.
+std::string_view httpdatenow();
+
+// Convert an expire offset of the form "(+|-)123(S|M|H|D|W|m|Y)" to a
+// time.  Returns false on success, or true if expire is not an offset.
+bool expireoffset(std::string_view expire, std::time_t& when);
+
+} // end namespace cgixx
+
+#endif // __cgixx_httpdate_h
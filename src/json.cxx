@@ -0,0 +1,914 @@
+/*
+ * json.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "jsontape.h"
+#include <cgixx/cgi.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cctype>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define CGIXX_X86_SIMD
+#	include <immintrin.h>
+#endif
+
+namespace cgixx {
+
+namespace {
+
+// Most of a size hint reserved up front, since the hint usually comes
+// from the client's CONTENT_LENGTH.
+const std::size_t maxreserve = 65536;
+
+[[noreturn]] void malformed()
+{
+	throw cgiexception("Malformed JSON body");
+}
+
+/*
+ * Character classes.  Anything that is not a quote, operator or space is
+ * part of a literal outside of strings.
+ */
+enum {
+	cls_quote = 1,
+	cls_backslash = 2,
+	cls_op = 4,
+	cls_space = 8,
+	cls_ctrl = 16
+};
+
+struct chartable {
+	unsigned char cls[256];
+
+	constexpr chartable() : cls()
+	{
+		for (int c = 0; c != 0x20; ++c)
+			cls[c] = cls_ctrl;
+		cls[int('"')] = cls_quote;
+		cls[int('\\')] = cls_backslash;
+		cls[int('{')] = cls[int('}')] = cls[int('[')] = cls[int(']')] = cls_op;
+		cls[int(':')] = cls[int(',')] = cls_op;
+		cls[int(' ')] = cls_space;
+		cls[int('\t')] = cls[int('\n')] = cls[int('\r')] = cls_space | cls_ctrl;
+	}
+};
+
+constexpr chartable chars;
+
+inline bool isliteral(unsigned char c)
+{
+	return !(chars.cls[c] & (cls_quote | cls_op | cls_space));
+}
+
+// Bit masks of the character classes of a 64 byte block.
+struct blockmasks {
+	std::uint64_t quote;
+	std::uint64_t backslash;
+	std::uint64_t op;
+	std::uint64_t space;
+	std::uint64_t ctrl;
+};
+
+void classify_scalar(const unsigned char* p, blockmasks& m)
+{
+	m.quote = m.backslash = m.op = m.space = m.ctrl = 0;
+	for (int i = 0; i != 64; ++i)
+	{
+		unsigned cls = chars.cls[p[i]];
+		if (!cls)
+			continue;
+		std::uint64_t bit = std::uint64_t(1) << i;
+		if (cls & cls_quote)
+			m.quote|= bit;
+		if (cls & cls_backslash)
+			m.backslash|= bit;
+		if (cls & cls_op)
+			m.op|= bit;
+		if (cls & cls_space)
+			m.space|= bit;
+		if (cls & cls_ctrl)
+			m.ctrl|= bit;
+	}
+}
+
+#ifdef CGIXX_X86_SIMD
+
+/*
+ * '{' and '[', and '}' and ']', differ only in bit 0x20, so setting it
+ * finds each pair with one compare.
+ */
+__attribute__((target("sse2")))
+void classify_sse2(const unsigned char* p, blockmasks& m)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i bit5 = _mm_set1_epi8(0x20);
+	const __m128i open = _mm_set1_epi8('{');
+	const __m128i close = _mm_set1_epi8('}');
+	const __m128i colon = _mm_set1_epi8(':');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i ctrlmax = _mm_set1_epi8(0x1f);
+
+	m.quote = m.backslash = m.op = m.space = m.ctrl = 0;
+	for (int i = 0; i != 64; i+= 16)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		__m128i lower = _mm_or_si128(x, bit5);
+		__m128i op = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(lower, open), _mm_cmpeq_epi8(lower, close)),
+			_mm_or_si128(_mm_cmpeq_epi8(x, colon), _mm_cmpeq_epi8(x, comma)));
+		__m128i ws = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(x, space), _mm_cmpeq_epi8(x, tab)),
+			_mm_or_si128(_mm_cmpeq_epi8(x, lf), _mm_cmpeq_epi8(x, cr)));
+		__m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(x, ctrlmax), x);
+		m.quote|= std::uint64_t(unsigned(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(x, quote)))) << i;
+		m.backslash|= std::uint64_t(unsigned(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(x, backslash)))) << i;
+		m.op|= std::uint64_t(unsigned(_mm_movemask_epi8(op))) << i;
+		m.space|= std::uint64_t(unsigned(_mm_movemask_epi8(ws))) << i;
+		m.ctrl|= std::uint64_t(unsigned(_mm_movemask_epi8(ctrl))) << i;
+	}
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const unsigned char* p, blockmasks& m)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i bit5 = _mm256_set1_epi8(0x20);
+	const __m256i open = _mm256_set1_epi8('{');
+	const __m256i close = _mm256_set1_epi8('}');
+	const __m256i colon = _mm256_set1_epi8(':');
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i ctrlmax = _mm256_set1_epi8(0x1f);
+
+	m.quote = m.backslash = m.op = m.space = m.ctrl = 0;
+	for (int i = 0; i != 64; i+= 32)
+	{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		__m256i lower = _mm256_or_si256(x, bit5);
+		__m256i op = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(lower, open),
+				_mm256_cmpeq_epi8(lower, close)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(x, colon),
+				_mm256_cmpeq_epi8(x, comma)));
+		__m256i ws = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(x, space), _mm256_cmpeq_epi8(x, tab)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(x, lf), _mm256_cmpeq_epi8(x, cr)));
+		__m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(x, ctrlmax), x);
+		m.quote|= std::uint64_t(std::uint32_t(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, quote)))) << i;
+		m.backslash|= std::uint64_t(std::uint32_t(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, backslash)))) << i;
+		m.op|= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(op))) << i;
+		m.space|= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(ws))) << i;
+		m.ctrl|= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(ctrl))) << i;
+	}
+}
+
+#endif // CGIXX_X86_SIMD
+
+typedef void (*classifyfunc)(const unsigned char*, blockmasks&);
+
+classifyfunc selectclassifier()
+{
+#ifdef CGIXX_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return classify_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return classify_sse2;
+#endif
+	return classify_scalar;
+}
+
+inline unsigned trailingzeros(std::uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	unsigned n = 0;
+	while (!(x & 1)) {
+		x>>= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+/*
+ * Each bit becomes the xor of itself and all lower bits, so between an
+ * opening and a closing quote the bits are set.
+ */
+inline std::uint64_t prefixxor(std::uint64_t x)
+{
+	x^= x << 1;
+	x^= x << 2;
+	x^= x << 4;
+	x^= x << 8;
+	x^= x << 16;
+	x^= x << 32;
+	return x;
+}
+
+/*
+ * Find the bytes escaped by a backslash.  carry is 1 if the first byte
+ * of the block is escaped by the last byte of the previous block, and is
+ * set likewise for the next block.
+ */
+inline std::uint64_t findescaped(std::uint64_t backslash, std::uint64_t& carry)
+{
+	std::uint64_t escaped = carry;
+	backslash&= ~carry;
+	carry = 0;
+	while (backslash)
+	{
+		unsigned i = trailingzeros(backslash);
+		if (i == 63)
+		{
+			carry = 1;
+			break;
+		}
+		// The escaped byte cannot escape another, even if a backslash.
+		escaped|= std::uint64_t(1) << (i + 1);
+		backslash&= ~(std::uint64_t(3) << i);
+	}
+	return escaped;
+}
+
+bool isnumber(const char* p, const char* end)
+{
+	if (p != end && *p == '-')
+		++p;
+	if (p == end)
+		return false;
+	if (*p == '0')
+		++p;
+	else if (*p >= '1' && *p <= '9')
+		while (p != end && *p >= '0' && *p <= '9')
+			++p;
+	else
+		return false;
+	if (p != end && *p == '.')
+	{
+		const char* digits = ++p;
+		while (p != end && *p >= '0' && *p <= '9')
+			++p;
+		if (p == digits)
+			return false;
+	}
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		if (++p != end && (*p == '+' || *p == '-'))
+			++p;
+		const char* digits = p;
+		while (p != end && *p >= '0' && *p <= '9')
+			++p;
+		if (p == digits)
+			return false;
+	}
+	return p == end;
+}
+
+bool hex4(const char* p, const char* end, unsigned& value)
+{
+	if (end - p < 4)
+		return false;
+	value = 0;
+	for (int i = 0; i != 4; ++i)
+	{
+		unsigned char c = p[i];
+		value<<= 4;
+		if (c >= '0' && c <= '9')
+			value|= c - '0';
+		else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+			value|= (c | 0x20) - 'a' + 10;
+		else
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Unescape a string in place.  The result is never longer than the
+ * escaped text.  Returns the new length.
+ */
+std::size_t unescape(char* s, std::size_t len)
+{
+	char* out = s;
+	const char* p = s;
+	const char* end = s + len;
+	while (p != end)
+	{
+		const char* bs = static_cast<const char*>(std::memchr(p, '\\', end - p));
+		if (!bs)
+			bs = end;
+		std::memmove(out, p, bs - p);
+		out+= bs - p;
+		if (bs == end)
+			break;
+		p = bs + 1;
+		if (p == end)
+			malformed();
+		switch (*p++)
+		{
+		case '"': *out++ = '"'; break;
+		case '\\': *out++ = '\\'; break;
+		case '/': *out++ = '/'; break;
+		case 'b': *out++ = '\b'; break;
+		case 'f': *out++ = '\f'; break;
+		case 'n': *out++ = '\n'; break;
+		case 'r': *out++ = '\r'; break;
+		case 't': *out++ = '\t'; break;
+		case 'u':
+			{
+				unsigned cp, low;
+				if (!hex4(p, end, cp))
+					malformed();
+				p+= 4;
+				if (cp >= 0xdc00 && cp < 0xe000)
+					malformed();
+				if (cp >= 0xd800 && cp < 0xdc00)
+				{
+					// A surrogate pair.
+					if (end - p < 6 || p[0] != '\\' || p[1] != 'u' ||
+						!hex4(p + 2, end, low) || low < 0xdc00 || low >= 0xe000)
+						malformed();
+					p+= 6;
+					cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+				}
+				if (cp < 0x80)
+					*out++ = char(cp);
+				else if (cp < 0x800)
+				{
+					*out++ = char(0xc0 | (cp >> 6));
+					*out++ = char(0x80 | (cp & 0x3f));
+				}
+				else if (cp < 0x10000)
+				{
+					*out++ = char(0xe0 | (cp >> 12));
+					*out++ = char(0x80 | ((cp >> 6) & 0x3f));
+					*out++ = char(0x80 | (cp & 0x3f));
+				}
+				else
+				{
+					*out++ = char(0xf0 | (cp >> 18));
+					*out++ = char(0x80 | ((cp >> 12) & 0x3f));
+					*out++ = char(0x80 | ((cp >> 6) & 0x3f));
+					*out++ = char(0x80 | (cp & 0x3f));
+				}
+			}
+			break;
+		default:
+			malformed();
+		}
+	}
+	return out - s;
+}
+
+bool iequals(std::string_view a, std::string_view b)
+{
+	if (a.length() != b.length())
+		return false;
+	for (std::size_t i = 0; i != a.length(); ++i)
+		if (std::tolower(static_cast<unsigned char>(a[i])) != b[i])
+			return false;
+	return true;
+}
+
+} // end anonymous namespace
+
+
+/*
+ * Check whether a content type is application/json, or another type
+ * with a +json suffix, ignoring any parameters.
+ *
+ */
+bool isjson(std::string_view contenttype)
+{
+	std::string_view type(contenttype.substr(0, contenttype.find(';')));
+	while (!type.empty() && (type.back() == ' ' || type.back() == '\t'))
+		type.remove_suffix(1);
+	while (!type.empty() && (type.front() == ' ' || type.front() == '\t'))
+		type.remove_prefix(1);
+	return iequals(type, "application/json") ||
+		(type.length() > 5 && iequals(type.substr(type.length() - 5), "+json"));
+}
+
+
+/*
+ * Start reading a body of sizehint bytes.  Offsets in the tape are 32
+ * bits, which bounds the body size.
+ *
+ */
+void jsondocument::begin(std::size_t sizehint)
+{
+	if (sizehint >= 0xffffffffUL)
+		throw cgiexception("JSON body too large");
+	body.erase();
+	nodes.clear();
+	parsed = false;
+	body.reserve(std::min(sizehint, maxreserve));
+}
+
+
+/*
+ * Parse the body that has been read.
+ *
+ */
+void jsondocument::finish()
+{
+	if (body.length() >= 0xffffffffUL)
+		throw cgiexception("JSON body too large");
+	std::pmr::vector<std::uint32_t> structurals(nodes.get_allocator());
+	scan(structurals);
+	parse(structurals);
+	parsed = true;
+}
+
+
+/*
+ * Find the structural characters outside of strings, each opening and
+ * closing quote, and the first byte of each literal.
+ *
+ */
+void jsondocument::scan(std::pmr::vector<std::uint32_t>& structurals)
+{
+	static const classifyfunc classify = selectclassifier();
+
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(body.data());
+	std::size_t len = body.length();
+	structurals.reserve(len / 4 + 16);
+	escapes = false;
+
+	std::uint64_t escapecarry = 0;	// first byte of block is escaped
+	std::uint64_t stringcarry = 0;	// all ones if block starts in a string
+	std::uint64_t literalcarry = 0;	// last byte of previous block was literal
+	unsigned char last[64];
+	blockmasks m;
+	for (std::size_t pos = 0; pos < len; pos+= 64)
+	{
+		const unsigned char* block = data + pos;
+		if (len - pos < 64)
+		{
+			// Pad the last block with spaces.
+			std::memset(last, ' ', sizeof(last));
+			std::memcpy(last, block, len - pos);
+			block = last;
+		}
+		classify(block, m);
+		if (m.backslash)
+			escapes = true;
+
+		std::uint64_t quote = m.quote & ~findescaped(m.backslash, escapecarry);
+		std::uint64_t instring = prefixxor(quote) ^ stringcarry;
+		stringcarry = std::uint64_t(std::int64_t(instring) >> 63);
+		if (m.ctrl & instring)
+			malformed();
+
+		std::uint64_t literal = ~(m.space | m.op | m.quote | instring);
+		std::uint64_t starts = literal & ~((literal << 1) | literalcarry);
+		literalcarry = literal >> 63;
+
+		std::uint64_t found = (m.op & ~instring) | quote | starts;
+		while (found)
+		{
+			structurals.push_back(
+				static_cast<std::uint32_t>(pos + trailingzeros(found)));
+			found&= found - 1;
+		}
+	}
+	if (stringcarry)
+		malformed();
+}
+
+
+/*
+ * Check the grammar and build the tape from the structural positions.
+ *
+ */
+void jsondocument::parse(const std::pmr::vector<std::uint32_t>& s)
+{
+	enum {
+		st_value,	// expecting a value
+		st_key,		// expecting a member name
+		st_next		// after a value
+	} state = st_value;
+	std::size_t i = 0, n = s.size();
+
+	// Every node but a key starts at a structural position.
+	nodes.reserve(n);
+	stack.clear();
+	for (;;)
+	{
+		if (i == n)
+		{
+			if (state == st_next && stack.empty())
+				break;
+			malformed();
+		}
+		std::uint32_t pos = s[i++];
+		char c = body[pos];
+		if (state == st_value)
+		{
+			if (c == '{' || c == '[')
+			{
+				add(c == '{' ? json_object : json_array, pos, 0);
+				stack.push_back(static_cast<std::uint32_t>(nodes.size() - 1));
+				if (i != n && body[s[i]] == c + 2)	// '}' or ']'
+				{
+					++i;
+					nodes[stack.back()].end = static_cast<std::uint32_t>(nodes.size());
+					stack.pop_back();
+					state = st_next;
+				}
+				else
+					state = c == '{' ? st_key : st_value;
+				continue;
+			}
+			if (c == '"')
+			{
+				if (i == n)
+					malformed();
+				addstring(pos, s[i++], false);
+			}
+			else if (chars.cls[static_cast<unsigned char>(c)] & cls_op)
+				malformed();
+			else
+				addliteral(pos);
+			state = st_next;
+		}
+		else if (state == st_key)
+		{
+			if (c != '"' || i == n)
+				malformed();
+			addstring(pos, s[i++], true);
+			if (i == n || body[s[i]] != ':')
+				malformed();
+			++i;
+			state = st_value;
+		}
+		else
+		{
+			if (stack.empty())
+				malformed();
+			node& top = nodes[stack.back()];
+			if (c == ',')
+				state = top.type == json_object ? st_key : st_value;
+			else if (c == (top.type == json_object ? '}' : ']'))
+			{
+				top.end = static_cast<std::uint32_t>(nodes.size());
+				stack.pop_back();
+			}
+			else
+				malformed();
+		}
+	}
+}
+
+
+/*
+ * Add a node, counting it as a child of the open container.
+ *
+ */
+void jsondocument::add(unsigned char type, std::uint32_t start,
+	std::uint32_t length)
+{
+	if (!stack.empty())
+		++nodes[stack.back()].length;
+	node n = { start, length, static_cast<std::uint32_t>(nodes.size() + 1), type };
+	nodes.push_back(n);
+}
+
+
+/*
+ * Add the string between two quotes, unescaping it in place.  Member
+ * names are not counted as children.
+ *
+ */
+void jsondocument::addstring(std::uint32_t open, std::uint32_t close, bool iskey)
+{
+	std::uint32_t start = open + 1;
+	std::size_t length = close - start;
+	if (escapes && std::memchr(body.data() + start, '\\', length))
+		length = unescape(&body[start], length);
+	if (iskey)
+	{
+		node n = { start, static_cast<std::uint32_t>(length),
+			static_cast<std::uint32_t>(nodes.size() + 1), json_string };
+		nodes.push_back(n);
+	}
+	else
+		add(json_string, start, static_cast<std::uint32_t>(length));
+}
+
+
+/*
+ * Add the number, true, false or null starting at pos.
+ *
+ */
+void jsondocument::addliteral(std::uint32_t pos)
+{
+	const char* begin = body.data() + pos;
+	const char* end = begin;
+	const char* limit = body.data() + body.length();
+	while (end != limit && isliteral(static_cast<unsigned char>(*end)))
+		++end;
+	std::string_view text(begin, end - begin);
+	unsigned char type;
+	if (text == "true")
+		type = json_true;
+	else if (text == "false")
+		type = json_false;
+	else if (text == "null")
+		type = json_null;
+	else if (isnumber(begin, end))
+		type = json_number;
+	else
+		malformed();
+	add(type, pos, static_cast<std::uint32_t>(text.length()));
+}
+
+
+/**
+ * Get the type of this value.
+ *
+ * @return  The type, or json_none if this does not refer to a value.
+ */
+jsontypes jsonvalue::gettype() const
+{
+	return doc ? jsontypes(doc->nodes[node].type) : json_none;
+}
+
+
+/**
+ * Get the text of a string, unescaped, or the literal text of a number.
+ *
+ * @return  The text, or an empty view for other types.
+ */
+std::string_view jsonvalue::getstring() const
+{
+	jsontypes type = gettype();
+	if (type != json_string && type != json_number)
+		return std::string_view();
+	return doc->str(doc->nodes[node]);
+}
+
+
+/**
+ * Get the value of a number as a double.
+ *
+ * @param   value   Reference to receive the number.
+ * @return  false on success;
+ * @return  true if this is not a number.
+ */
+bool jsonvalue::getnumber(double& value) const
+{
+	if (gettype() != json_number)
+		return true;
+	std::string_view text(getstring());
+	std::from_chars_result r = std::from_chars(text.data(),
+		text.data() + text.length(), value);
+	return r.ec != std::errc() || r.ptr != text.data() + text.length();
+}
+
+
+/**
+ * Get the value of a number as an integer.
+ *
+ * @param   value   Reference to receive the number.
+ * @return  false on success;
+ * @return  true if this is not an integer that fits in a long long.
+ */
+bool jsonvalue::getnumber(long long& value) const
+{
+	if (gettype() != json_number)
+		return true;
+	std::string_view text(getstring());
+	std::from_chars_result r = std::from_chars(text.data(),
+		text.data() + text.length(), value);
+	return r.ec != std::errc() || r.ptr != text.data() + text.length();
+}
+
+
+/**
+ * Get the value of true or false.
+ *
+ * @param   value   Reference to receive the value.
+ * @return  false on success;
+ * @return  true if this is not true or false.
+ */
+bool jsonvalue::getbool(bool& value) const
+{
+	jsontypes type = gettype();
+	if (type != json_true && type != json_false)
+		return true;
+	value = type == json_true;
+	return false;
+}
+
+
+/**
+ * Get the number of elements of an array or members of an object.
+ *
+ * @return  The number of children, or 0 for other types.
+ */
+std::size_t jsonvalue::size() const
+{
+	jsontypes type = gettype();
+	if (type != json_array && type != json_object)
+		return 0;
+	return doc->nodes[node].length;
+}
+
+
+/**
+ * Get the first element of an array or the value of the first member of
+ * an object.  Use next to visit the rest in order.
+ *
+ * @return  The value, which does not exist if there are no children.
+ */
+jsonvalue jsonvalue::first() const
+{
+	if (!size())
+		return jsonvalue();
+	std::uint32_t child = node + 1;
+	if (gettype() == json_object)
+		++child;	// skip the name
+	return doc->value(child, node + 1);
+}
+
+
+/**
+ * Get the next element or member value after this one.
+ *
+ * @return  The value, which does not exist after the last child.
+ */
+jsonvalue jsonvalue::next() const
+{
+	if (!doc || !parent)
+		return jsonvalue();
+	const jsondocument::node& p = doc->nodes[parent - 1];
+	std::uint32_t n = doc->nodes[node].end;
+	if (n >= p.end)
+		return jsonvalue();
+	if (p.type == json_object)
+		++n;	// skip the name
+	return doc->value(n, parent);
+}
+
+
+/**
+ * Get the name of the object member whose value this is.
+ *
+ * @return  The name, or an empty view if this is not a member value.
+ */
+std::string_view jsonvalue::getkey() const
+{
+	if (!doc || !parent || doc->nodes[parent - 1].type != json_object)
+		return std::string_view();
+	return doc->str(doc->nodes[node - 1]);
+}
+
+
+/**
+ * Get an element of an array, counting from 0.  Elements are reached by
+ * skipping the ones before; use first and next to visit them all.
+ *
+ * @param   index   Position of the element.
+ * @return  The element, which does not exist if index is out of range.
+ */
+jsonvalue jsonvalue::at(std::size_t index) const
+{
+	if (gettype() != json_array || index >= size())
+		return jsonvalue();
+	jsonvalue v(first());
+	while (index--)
+		v = v.next();
+	return v;
+}
+
+
+/**
+ * Get the value of the member of an object with the specified name.  If
+ * the name appears more than once, the first is returned.
+ *
+ * @param   key     Name of the member.
+ * @return  The value, which does not exist if there is no such member.
+ */
+jsonvalue jsonvalue::member(std::string_view key) const
+{
+	if (gettype() != json_object)
+		return jsonvalue();
+	const jsondocument::node& obj = doc->nodes[node];
+	for (std::uint32_t i = node + 1; i < obj.end; i = doc->nodes[i + 1].end)
+		if (doc->str(doc->nodes[i]) == key)
+			return doc->value(i + 1, node + 1);
+	return jsonvalue();
+}
+
+
+/**
+ * Find a value below this one by JSON pointer (RFC 6901), such as
+ * "/items/0/id".  In a name, ~1 stands for / and ~0 for ~.  An empty
+ * pointer refers to this value.
+ *
+ * @param   pointer The JSON pointer.
+ * @return  The value, which does not exist if the path does not.
+ */
+jsonvalue jsonvalue::find(std::string_view pointer) const
+{
+	jsonvalue v(*this);
+	if (pointer.empty())
+		return v;
+	if (pointer[0] != '/')
+		return jsonvalue();
+
+	std::string unescaped;
+	std::size_t pos = 1;
+	for (;;)
+	{
+		std::size_t slash = pointer.find('/', pos);
+		std::string_view token(pointer.substr(pos,
+			slash == std::string_view::npos ? std::string_view::npos : slash - pos));
+		if (token.find('~') != std::string_view::npos)
+		{
+			unescaped.erase();
+			for (std::size_t i = 0; i != token.length(); ++i)
+			{
+				if (token[i] == '~' && i + 1 != token.length() &&
+					(token[i + 1] == '0' || token[i + 1] == '1'))
+					unescaped+= token[++i] == '0' ? '~' : '/';
+				else
+					unescaped+= token[i];
+			}
+			token = unescaped;
+		}
+
+		if (v.gettype() == json_object)
+			v = v.member(token);
+		else if (v.gettype() == json_array)
+		{
+			std::size_t index = 0;
+			std::from_chars_result r = std::from_chars(token.data(),
+				token.data() + token.length(), index);
+			if (token.empty() || (token[0] == '0' && token.length() > 1) ||
+				r.ec != std::errc() || r.ptr != token.data() + token.length())
+				return jsonvalue();
+			v = v.at(index);
+		}
+		else
+			return jsonvalue();
+
+		if (!v.exists() || slash == std::string_view::npos)
+			return v;
+		pos = slash + 1;
+	}
+}
+
+} // end namespace cgixx
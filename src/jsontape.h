@@ -0,0 +1,114 @@
+/*
+ * jsontape.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_jsontape_h
+#define __cgixx_jsontape_h
+
+#include <cgixx/json.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+namespace cgixx {
+
+/*
+ * jsondocument holds an application/json body and a tape describing it.
+ * The body is read once into a buffer and parsed in place: strings are
+ * unescaped over their own text, so every string and number is a span of
+ * the buffer.  The tape is one array of nodes in document order, with a
+ * container's members following it and each node recording where its
+ * subtree ends, so values are found by skipping whole subtrees.
+ *
+ * Parsing takes two passes, as simdjson does.  The first classifies the
+ * body 64 bytes at a time into bit masks, with SSE2 or AVX2 when the CPU
+ * supports them, and from these finds every structural character and
+ * the start of every literal outside of strings.  The second walks only
+ * those positions to check the grammar and build the tape.
+ */
+struct jsondocument {
+	struct node {
+		std::uint32_t start;	// offset of the text in body
+		std::uint32_t length;	// text length, or number of children
+		std::uint32_t end;	// index of the node after this subtree
+		unsigned char type;	// jsontypes
+	};
+
+	explicit jsondocument(std::pmr::memory_resource* resource =
+		std::pmr::get_default_resource()) : body(resource),
+		nodes(resource), parsed(false), stack(resource), escapes(false) {}
+
+	// Read the body incrementally, then parse it.
+	void begin(std::size_t sizehint);
+	void feed(const char* data, std::size_t len)
+	{ body.append(data, len); }
+	void finish();
+
+	// Get the root value, which does not exist unless a body was parsed.
+	jsonvalue root() const
+	{ return parsed ? jsonvalue(this, 0, 0) : jsonvalue(); }
+
+	jsonvalue value(std::uint32_t n, std::uint32_t parent) const
+	{ return jsonvalue(this, n, parent); }
+
+	std::string_view str(const node& n) const
+	{ return std::string_view(body.data() + n.start, n.length); }
+
+	std::pmr::string body;
+	std::pmr::vector<node> nodes;
+	bool parsed;
+
+private:
+	void scan(std::pmr::vector<std::uint32_t>& structurals);
+	void parse(const std::pmr::vector<std::uint32_t>& structurals);
+	void addstring(std::uint32_t open, std::uint32_t close, bool iskey);
+	void addliteral(std::uint32_t pos);
+	void add(unsigned char type, std::uint32_t start, std::uint32_t length);
+
+	std::pmr::vector<std::uint32_t> stack;	// open containers
+	bool escapes;				// body has a backslash
+};
+
+// Check for an application/json or +json content type.
+bool isjson(std::string_view contenttype);
+
+} // end namespace cgixx
+
+#endif // __cgixx_jsontape_h
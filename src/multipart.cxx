@@ -0,0 +1,527 @@
+/*
+ * multipart.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "compat.h"
+
+#include "multipart.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace cgixx {
+
+namespace {
+
+// Largest block of part headers accepted.
+const std::size_t maxheaders = 16384;
+
+bool iequals(const std::string& a, const char* b)
+{
+	std::size_t len = std::strlen(b);
+	if (a.length() != len)
+		return false;
+	for (std::size_t i = 0; i != len; ++i)
+		if (std::tolower(static_cast<unsigned char>(a[i])) != b[i])
+			return false;
+	return true;
+}
+
+std::string trim(const std::string& s)
+{
+	std::size_t first = s.find_first_not_of(" \t");
+	if (first == std::string::npos)
+		return std::string();
+	return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+}
+
+/*
+ * Split header parameters of the form ; key=value; key="value" into
+ * calls to param.  Quoted values may contain backslash escapes.
+ */
+template <class F>
+void parseparameters(const std::string& value, std::size_t pos, F param)
+{
+	std::size_t len = value.length();
+	while (pos < len)
+	{
+		if (value[pos] == ';' || value[pos] == ' ' || value[pos] == '\t')
+		{
+			++pos;
+			continue;
+		}
+		std::size_t eq = value.find_first_of("=;", pos);
+		if (eq == std::string::npos || value[eq] == ';')
+		{
+			pos = eq;
+			continue;
+		}
+		std::string key(trim(value.substr(pos, eq - pos)));
+		std::string val;
+		pos = eq + 1;
+		while (pos < len && (value[pos] == ' ' || value[pos] == '\t'))
+			++pos;
+		if (pos < len && value[pos] == '"')
+		{
+			for (++pos; pos < len && value[pos] != '"'; ++pos)
+			{
+				if (value[pos] == '\\' && pos + 1 < len)
+					++pos;
+				val+= value[pos];
+			}
+			++pos;	// skip '"'
+		}
+		else
+		{
+			std::size_t end = value.find(';', pos);
+			if (end == std::string::npos)
+				end = len;
+			val = trim(value.substr(pos, end - pos));
+			pos = end;
+		}
+		param(key, val);
+	}
+}
+
+#ifndef _WIN32
+void writeall(int fd, const char* data, std::size_t len)
+{
+	while (len)
+	{
+		ssize_t x = ::write(fd, data, len);
+		if (x > 0)
+		{
+			data+= x;
+			len-= x;
+		}
+		else if (x == 0 || errno != EINTR)
+			throw cgiexception("Cannot write temporary file for upload");
+	}
+}
+#endif
+
+} // end anonymous namespace
+
+
+upload_impl::~upload_impl()
+{
+#ifndef _WIN32
+	if (map)
+		::munmap(map, size);
+	if (fd >= 0)
+		::close(fd);
+#endif
+}
+
+
+/*
+ * Check whether contenttype is multipart/form-data and, if it is,
+ * extract the boundary parameter.  The boundary is left empty when the
+ * content type does not name one.
+ *
+ */
+bool ismultipart(const std::string& contenttype, std::string& boundary)
+{
+	std::size_t semi = contenttype.find(';');
+	if (!iequals(trim(contenttype.substr(0, semi)), "multipart/form-data"))
+		return false;
+	boundary.erase();
+	if (semi != std::string::npos)
+		parseparameters(contenttype, semi,
+			[&boundary](const std::string& key, const std::string& val) {
+				if (iequals(key, "boundary"))
+					boundary = val;
+			});
+	return true;
+}
+
+
+multipartparser::multipartparser(const std::string& boundary,
+	ParameterList& v, uploadlist& u, const cgioptions& opts)
+	: delim("\r\n--", u.get_allocator().resource()),
+	buf("\r\n", u.get_allocator().resource()), state(st_preamble),
+	vars(v), uploads(u), file(0), threshold(opts.spillthreshold),
+	tempdir(opts.tempdir.data(), opts.tempdir.length(),
+		u.get_allocator().resource())
+{
+	// The CRLF in buf lets a delimiter at the very start of the body
+	// match like any other.
+	delim+= boundary;
+	if (tempdir.empty())
+	{
+		const char* t = std::getenv("TMPDIR");
+		tempdir = t && *t ? t : "/tmp";
+	}
+	vars.begin(0);
+}
+
+
+multipartparser::~multipartparser()
+{
+	delete file;
+}
+
+
+/*
+ * Parse the next chunk of the body.
+ *
+ */
+void multipartparser::feed(const char* data, std::size_t len)
+{
+	buf.append(data, len);
+	std::size_t pos = 0, found;
+	while (pos < buf.length())
+	{
+		if (state == st_preamble || state == st_body)
+		{
+			found = find(pos);
+			if (found == std::string::npos)
+			{
+				// Hold back anything that could start a delimiter.
+				std::size_t keep = std::min(buf.length() - pos,
+					delim.length() - 1);
+				if (state == st_body)
+					partdata(buf.data() + pos, buf.length() - keep - pos);
+				pos = buf.length() - keep;
+				break;
+			}
+			if (state == st_body)
+			{
+				partdata(buf.data() + pos, found - pos);
+				endpart();
+			}
+			pos = found + delim.length();
+			state = st_delimiter;
+		}
+		else if (state == st_delimiter)
+		{
+			// Transport padding, then CRLF, or "--" after the last part.
+			while (pos < buf.length() && (buf[pos] == ' ' || buf[pos] == '\t'))
+				++pos;
+			if (buf.length() - pos < 2)
+				break;
+			if (buf.compare(pos, 2, "--") == 0)
+			{
+				state = st_done;
+				continue;
+			}
+			if (buf.compare(pos, 2, "\r\n") != 0)
+				throw cgiexception("Malformed multipart/form-data body");
+			// Leave the CRLF so an empty header block ends at pos.
+			state = st_headers;
+		}
+		else if (state == st_headers)
+		{
+			found = buf.find("\r\n\r\n", pos);
+			if (found == std::string::npos)
+			{
+				if (buf.length() - pos > maxheaders)
+					throw cgiexception("Multipart/form-data headers too large");
+				break;
+			}
+			startpart(pos + 2, found > pos ? found - pos - 2 : 0);
+			pos = found + 4;
+			state = st_body;
+		}
+		else
+		{
+			// Ignore the epilogue.
+			pos = buf.length();
+		}
+	}
+	buf.erase(0, pos);
+}
+
+
+/*
+ * Check that the body ended after the last part and build the index of
+ * form fields.
+ *
+ */
+void multipartparser::finish()
+{
+	if (state != st_done)
+		throw cgiexception("Unexpected end of multipart/form-data body");
+	vars.index();
+}
+
+
+/*
+ * Find the next delimiter at or after pos.
+ *
+ */
+std::size_t multipartparser::find(std::size_t pos) const
+{
+	const char* begin = buf.data();
+	const char* end = begin + buf.length();
+	const char* p = begin + pos;
+	std::size_t len = delim.length();
+	while ((p = static_cast<const char*>(std::memchr(p, '\r', end - p))))
+	{
+		if (static_cast<std::size_t>(end - p) < len)
+			break;
+		if (std::memcmp(p, delim.data(), len) == 0)
+			return p - begin;
+		++p;
+	}
+	return std::string::npos;
+}
+
+
+/*
+ * Start a part from its header block buf[pos, pos+len).
+ *
+ */
+void multipartparser::startpart(std::size_t pos, std::size_t len)
+{
+	std::string name, filename, type;
+	bool isfile = false;
+	std::size_t end = pos + len;
+	while (pos < end)
+	{
+		std::size_t eol = buf.find("\r\n", pos);
+		if (eol == std::string::npos || eol > end)
+			eol = end;
+		std::size_t colon = buf.find(':', pos);
+		if (colon < eol)
+		{
+			std::string hdr(trim(std::string(buf.data() + pos, colon - pos)));
+			std::string value(trim(std::string(buf.data() + colon + 1,
+				eol - colon - 1)));
+			if (iequals(hdr, "content-disposition"))
+				parseparameters(value, value.find(';'),
+					[&](const std::string& key, const std::string& val) {
+						if (iequals(key, "name"))
+							name = val;
+						else if (iequals(key, "filename"))
+						{
+							filename = val;
+							isfile = true;
+						}
+					});
+			else if (iequals(hdr, "content-type"))
+				type = value;
+		}
+		pos = eol + 2;
+	}
+
+	vars.checkcount(vars.entries.size() + uploads.size());
+	vars.checklength(false, name.length());
+	if (isfile)
+	{
+		file = new upload_impl(uploads.get_allocator().resource());
+		file->name = name;
+		file->filename = filename;
+		file->type = type;
+	}
+	else
+		vars.beginraw(name);
+}
+
+
+/*
+ * Store the next piece of the current part.
+ *
+ */
+void multipartparser::partdata(const char* data, std::size_t len)
+{
+	if (!len)
+		return;
+	if (!file)
+	{
+		vars.appendraw(data, len);
+		return;
+	}
+	if (file->fd < 0 && file->memory.length() + len > threshold)
+		spill();
+#ifndef _WIN32
+	if (file->fd >= 0)
+		writeall(file->fd, data, len);
+	else
+#endif
+		file->memory.append(data, len);
+	file->size+= len;
+}
+
+
+void multipartparser::endpart()
+{
+	if (file)
+	{
+		uploads.push_back(std::unique_ptr<upload>(new upload(file)));
+		file = 0;
+	}
+	else
+		vars.endraw();
+}
+
+
+/*
+ * Move the current file part from memory to an unlinked temporary file.
+ * On Win32 files always stay in memory.
+ *
+ */
+void multipartparser::spill()
+{
+#ifndef _WIN32
+	std::string path(tempdir.data(), tempdir.length());
+	path+= "/cgixxXXXXXX";
+	int fd = ::mkstemp(&path[0]);
+	if (fd < 0)
+		throw cgiexception("Cannot create temporary file for upload");
+	::unlink(path.c_str());
+	file->fd = fd;
+	writeall(fd, file->memory.data(), file->memory.length());
+	file->memory.clear();
+	file->memory.shrink_to_fit();
+#endif
+}
+
+
+upload::upload(upload_impl* i) : imp(i)
+{
+}
+
+
+/**
+ * Destroy *this upload, removing its temporary file.
+ */
+upload::~upload()
+{
+	delete imp;
+}
+
+
+/**
+ * Get the name of the form field that sent this file.
+ *
+ * @return	The field name.
+ */
+const std::string& upload::getname() const
+{
+	return imp->name;
+}
+
+
+/**
+ * Get the file name sent by the client.  The name comes from the client
+ * and must not be trusted as a path.
+ *
+ * @return	The file name.
+ */
+const std::string& upload::getfilename() const
+{
+	return imp->filename;
+}
+
+
+/**
+ * Get the content type sent by the client for this file.
+ *
+ * @return	The content type, or an empty string if none was sent.
+ */
+const std::string& upload::gettype() const
+{
+	return imp->type;
+}
+
+
+/**
+ * Get the size of this file in bytes.
+ *
+ * @return	The file size.
+ */
+std::size_t upload::size() const
+{
+	return imp->size;
+}
+
+
+/**
+ * Check whether this file is held in memory rather than in a temporary
+ * file.
+ *
+ * @return	true if the file is in memory.
+ */
+bool upload::inmemory() const
+{
+	return imp->fd < 0;
+}
+
+
+/**
+ * Get the contents of this file.  A file in a temporary file is memory
+ * mapped on the first call.
+ *
+ * @return	Pointer to size() bytes;
+ * @return	0 if the temporary file cannot be mapped.
+ */
+const char* upload::data() const
+{
+	if (imp->fd < 0)
+		return imp->memory.data();
+#ifndef _WIN32
+	if (!imp->map && imp->size)
+	{
+		void* m = ::mmap(0, imp->size, PROT_READ, MAP_PRIVATE, imp->fd, 0);
+		if (m == MAP_FAILED)
+			return 0;
+		imp->map = m;
+	}
+#endif
+	return static_cast<const char*>(imp->map);
+}
+
+
+/**
+ * Get the descriptor of the temporary file holding this file.  The
+ * descriptor is owned by the upload; the file is already unlinked.
+ *
+ * @return	The descriptor, or -1 if the file is held in memory.
+ */
+int upload::getfd() const
+{
+	return imp->fd;
+}
+
+} // end namespace cgixx
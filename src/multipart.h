@@ -0,0 +1,114 @@
+/*
+ * multipart.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __cgixx_multipart_h
+#define __cgixx_multipart_h
+
+#include "paramlist.h"
+#include <cgixx/cgi.h>
+#include <cgixx/upload.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <cstddef>
+
+namespace cgixx {
+
+struct upload_impl {
+	explicit upload_impl(std::pmr::memory_resource* resource)
+		: memory(resource), size(0), fd(-1), map(0) {}
+	~upload_impl();
+
+	std::string name;
+	std::string filename;
+	std::string type;
+	std::pmr::string memory;	// contents, until spilled
+	std::size_t size;
+	int fd;			// temporary file, or -1
+	mutable void* map;	// mapping of the temporary file
+};
+
+/*
+ * Streaming parser for multipart/form-data bodies.  Input is fed in
+ * chunks of any size.  Only the bytes that might start a delimiter are
+ * carried between chunks; part contents are handed on as soon as they
+ * are known not to be part of a delimiter.  Parts without a filename are
+ * added to vars, and file parts become uploads.
+ */
+class multipartparser {
+public:
+	typedef std::pmr::vector< std::unique_ptr<upload> > uploadlist;
+
+	multipartparser(const std::string& boundary, ParameterList& vars,
+		uploadlist& uploads, const cgioptions& opts);
+	~multipartparser();
+
+	void feed(const char* data, std::size_t len);
+	void finish();
+
+private:
+	enum states {
+		st_preamble,
+		st_delimiter,
+		st_headers,
+		st_body,
+		st_done
+	};
+
+	std::size_t find(std::size_t pos) const;
+	void startpart(std::size_t pos, std::size_t len);
+	void partdata(const char* data, std::size_t len);
+	void endpart();
+	void spill();
+
+	std::pmr::string delim;	// CRLF "--" boundary
+	std::pmr::string buf;	// unprocessed input
+	states state;
+	ParameterList& vars;
+	uploadlist& uploads;
+	upload_impl* file;	// file part being read, or 0
+	std::size_t threshold;
+	std::pmr::string tempdir;
+};
+
+// Check for a multipart/form-data content type and extract its boundary.
+bool ismultipart(const std::string& contenttype, std::string& boundary);
+
+} // end namespace cgixx
+
+#endif // __cgixx_multipart_h
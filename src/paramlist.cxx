@@ -0,0 +1,377 @@
+/*
+ * paramlist.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "paramlist.h"
+#include "cgi_impl.h"
+#include "siphash.h"
+#include "cookiescan.h"
+#include <algorithm>
+#include <cstring>
+
+namespace cgixx {
+
+namespace {
+
+// Name given to the value of an ISINDEX query.
+const char isindex[] = "query_string";
+
+// Most of a size hint reserved up front.  The hint usually comes from the
+// client's CONTENT_LENGTH, so the arena grows past this only as the
+// input actually arrives.
+const std::size_t maxreserve = 65536;
+
+} // end anonymous namespace
+
+
+/*
+ * Parse a url-encoded parameter list.  Identifiers are delimited by =
+ * and values are delimited by & or the end of the input.  Input that
+ * contains no = at all is an ISINDEX query, stored as "query_string".
+ *
+ */
+void ParameterList::parseparams(std::string_view paramlist)
+{
+	begin(paramlist.length());
+	std::size_t count = std::count(paramlist.begin(), paramlist.end(), '=');
+	entries.reserve(maxentries ? std::min(count, maxentries) : count);
+	feed(paramlist.data(), paramlist.length());
+	finish();
+}
+
+
+/*
+ * Start incremental parsing.  The arena is reserved for sizehint bytes
+ * of input, up to maxreserve, and grows from there as input is fed.
+ *
+ */
+void ParameterList::begin(std::size_t sizehint)
+{
+	arena.erase();
+	entries.clear();
+	groups.clear();
+	views.clear();
+	slots.clear();
+	if (sizehint)
+		arena.reserve(std::min(sizehint, maxreserve) + sizeof(isindex) - 1);
+	invalue = false;
+	sawequals = false;
+	tokstart = 0;
+}
+
+
+/*
+ * Parse the next chunk of input.  Names and values may be split across
+ * chunks at any byte, including inside an escape.  Note that & does not
+ * end a name, so "a&b=c" names a value "a&b", as it always has.
+ *
+ */
+void ParameterList::feed(const char* data, std::size_t len)
+{
+	const char* end = data + len;
+	while (data != end)
+	{
+		const char* p = static_cast<const char*>(
+			std::memchr(data, invalue ? '&' : '=', end - data));
+		std::size_t n = (p ? p : end) - data;
+		checklength(invalue, arena.length() - tokstart + n);
+		arena.append(data, n);
+		if (!p)
+			return;
+		if (invalue)
+			endvalue();
+		else
+		{
+			pending = decode(tokstart, arena.length() - tokstart);
+			arena.resize(pending.offset + pending.length);
+			tokstart = arena.length();
+			invalue = true;
+			sawequals = true;
+		}
+		data = p + 1;
+	}
+}
+
+
+/*
+ * Finish incremental parsing and build the index.  A trailing name
+ * without a value is dropped.
+ *
+ */
+void ParameterList::finish()
+{
+	if (invalue)
+		endvalue();
+	else if (!sawequals && !arena.empty())
+	{
+		// ISINDEX
+		span name = { arena.length(), sizeof(isindex) - 1 };
+		std::size_t len = arena.length();
+		arena.append(isindex, sizeof(isindex) - 1);
+		add(name, 0, len);
+	}
+	else
+		arena.resize(tokstart);
+	index();
+}
+
+
+/*
+ * Store the value being read and cut the arena back to its end.
+ *
+ */
+void ParameterList::endvalue()
+{
+	add(pending, tokstart, arena.length() - tokstart);
+	const span& value = entries.back().value;
+	arena.resize(value.offset + value.length);
+	tokstart = arena.length();
+	invalue = false;
+}
+
+
+/*
+ * Start a value that is not url-encoded, such as a multipart/form-data
+ * field.  Its contents follow through appendraw.
+ *
+ */
+void ParameterList::beginraw(std::string_view name)
+{
+	pending.offset = arena.length();
+	pending.length = name.length();
+	arena.append(name.data(), name.length());
+	tokstart = arena.length();
+}
+
+
+/*
+ * Store the value started by beginraw as it is.
+ *
+ */
+void ParameterList::endraw()
+{
+	span value = { tokstart, arena.length() - tokstart };
+	entry e = { pending, value, entries.size(), true };
+	entries.push_back(e);
+	tokstart = arena.length();
+}
+
+
+/*
+ * Parse cookies from the HTTP_COOKIE environment variable.
+ * Format: id=val; id=val; id=val
+ *
+ * The header is copied to the arena once and tokenized there.  Names and
+ * values without escapes are stored without being decoded.
+ *
+ */
+void ParameterList::parsecookies(std::string_view cookielist)
+{
+	arena.assign(cookielist);
+	entries.clear();
+	groups.clear();
+	views.clear();
+	slots.clear();
+	std::size_t count = std::count(arena.begin(), arena.end(), '=');
+	entries.reserve(maxentries ? std::min(count, maxentries) : count);
+
+	cookiescanner scanner(arena);
+	cookiescanner::token t;
+	while (!scanner.next(t))
+	{
+		checklength(false, t.name.length());
+		span name = { std::size_t(t.name.data() - arena.data()),
+			t.name.length() };
+		if (t.nameescaped)
+			name = decode(name.offset, name.length);
+		checklength(true, t.value.length());
+		add(name, t.value.data() - arena.data(), t.value.length(),
+			t.valueescaped);
+	}
+	index();
+}
+
+
+/*
+ * Find the group of values for the specified name.
+ *
+ */
+ParameterList::group* ParameterList::find(std::string_view name)
+{
+	return const_cast<group*>(
+		static_cast<const ParameterList*>(this)->find(name));
+}
+
+const ParameterList::group* ParameterList::find(std::string_view name) const
+{
+	if (slots.empty())
+	{
+		std::pmr::vector<group>::const_iterator it(std::lower_bound(groups.begin(),
+			groups.end(), name,
+			[this](const group& g, std::string_view n) { return str(g.name) < n; }));
+		if (it == groups.end() || str(it->name) != name)
+			return 0;
+		return &*it;
+	}
+
+	std::uint64_t h = siphash(name.data(), name.length(), processkey());
+	std::uint32_t tag = static_cast<std::uint32_t>(h >> 32);
+	for (std::size_t i = h & mask;; i = (i + 1) & mask)
+	{
+		const slot& s = slots[i];
+		if (!s.group)
+			return 0;
+		if (s.hash == tag)
+		{
+			const group& g = groups[s.group - 1];
+			if (str(g.name) == name)
+				return &g;
+		}
+	}
+}
+
+
+/*
+ * Percent-decode a run of the arena in place.  The decoded text is never
+ * longer than the input, so it is written over the start of the run.
+ *
+ */
+ParameterList::span ParameterList::decode(std::size_t offset,
+	std::size_t length)
+{
+	span s = { offset, cgi2text(&arena[0] + offset, length) };
+	return s;
+}
+
+
+/*
+ * Add an entry.  The value is decoded now unless in lazy mode, or known
+ * to contain no escapes.
+ *
+ */
+void ParameterList::add(const span& name, std::size_t offset,
+	std::size_t length, bool escaped)
+{
+	checkcount(entries.size());
+	span value = { offset, length };
+	entry e = { name, value, entries.size(), !escaped };
+	if (!lazy && escaped) {
+		e.value = decode(offset, length);
+		e.decoded = true;
+	}
+	entries.push_back(e);
+}
+
+
+void ParameterList::toolong(bool value) const
+{
+	std::string what(kind);
+	what[0] = std::toupper(static_cast<unsigned char>(what[0]));
+	throw cgiexception(what + (value ? " value too long" : " name too long"));
+}
+
+
+void ParameterList::toomany() const
+{
+	throw cgiexception(std::string("Too many ") + kind + "s");
+}
+
+
+/*
+ * Order the entries by name, keeping arrival order within a name, and
+ * build one group per distinct name and the array of value views.
+ *
+ */
+void ParameterList::index()
+{
+	std::sort(entries.begin(), entries.end(),
+		[this](const entry& a, const entry& b) {
+			int c = str(a.name).compare(str(b.name));
+			return c < 0 || (c == 0 && a.seq < b.seq);
+		});
+
+	views.reserve(entries.size());
+	for (std::size_t j = 0; j != entries.size(); ++j)
+		views.push_back(str(entries[j].value));
+
+	groups.reserve(entries.size());
+	std::size_t i = 0, end = entries.size();
+	while (i != end)
+	{
+		group g = { entries[i].name, i, 0, 0 };
+		std::string_view name(str(g.name));
+		while (i != end && str(entries[i].name) == name)
+			++i;
+		g.count = i - g.first;
+		groups.push_back(g);
+	}
+	buildslots();
+}
+
+
+/*
+ * Build the hash index over groups.  A few groups are searched faster
+ * by binary search, so the table is left empty for them.
+ *
+ */
+void ParameterList::buildslots()
+{
+	slots.clear();
+	if (groups.size() <= 8)
+		return;
+
+	// Keep the table at most half full.
+	std::size_t size = 16;
+	while (size < groups.size() * 2)
+		size*= 2;
+	slot empty = { 0, 0 };
+	slots.assign(size, empty);
+	mask = size - 1;
+
+	const sipkey& key = processkey();
+	for (std::size_t g = 0; g != groups.size(); ++g)
+	{
+		std::string_view name(str(groups[g].name));
+		std::uint64_t h = siphash(name.data(), name.length(), key);
+		std::size_t i = h & mask;
+		while (slots[i].group)
+			i = (i + 1) & mask;
+		slots[i].hash = static_cast<std::uint32_t>(h >> 32);
+		slots[i].group = static_cast<std::uint32_t>(g + 1);
+	}
+}
+
+} // end namespace cgixx
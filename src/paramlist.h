@@ -0,0 +1,201 @@
+/*
+ * paramlist.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __cgixx_paramlist_h
+#define __cgixx_paramlist_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+namespace cgixx {
+
+/*
+ * ParameterList holds the name/value pairs of one request.  The raw
+ * input is copied once into an arena and percent-decoded in place, so
+ * every name and value is a span of the arena instead of a string of its
+ * own.  After parsing, entries are ordered by name (and by arrival within
+ * a name) so that the values of one name are contiguous, and a group per
+ * distinct name records where its values start and how many have been
+ * consumed by get.  Groups stay ordered by name for the identifier lists
+ * and are found through an open-addressing hash table keyed with a
+ * per-process SipHash key, so names chosen to collide do not degrade
+ * lookups.
+ *
+ * Url-encoded input can be fed in chunks as it arrives.  Each token is
+ * decoded in place as soon as its delimiter is seen and the arena is cut
+ * back to the decoded text, so apart from the stored values only the raw
+ * bytes of the token being read are held.
+ *
+ * In lazy mode values are only tokenized while parsing and are decoded
+ * in place the first time they are retrieved.  Names are always decoded
+ * while parsing because the index is ordered by decoded name.
+ */
+struct ParameterList {
+	// Offset and length of a run of bytes in the arena.
+	struct span {
+		std::size_t offset;
+		std::size_t length;
+	};
+
+	struct entry {
+		span name;
+		span value;
+		std::size_t seq;	// arrival order
+		bool decoded;		// value has been decoded
+	};
+
+	struct group {
+		span name;
+		std::size_t first;	// index of first entry
+		std::size_t count;	// number of entries
+		std::size_t next;	// entries consumed so far
+	};
+
+	explicit ParameterList(std::pmr::memory_resource* resource =
+		std::pmr::get_default_resource()) : lazy(false), kind("parameter"),
+		maxentries(0), maxname(0), maxvalue(0), arena(resource),
+		entries(resource), groups(resource), views(resource),
+		slots(resource), mask(0), invalue(false), sawequals(false),
+		tokstart(0) {}
+
+	// Parse id=val&id=val input, or a single ISINDEX value.
+	void parseparams(std::string_view paramlist);
+
+	// Parse id=val&id=val input incrementally.
+	void begin(std::size_t sizehint);
+	void feed(const char* data, std::size_t len);
+	void finish();
+
+	// Add values that are not url-encoded, each possibly in pieces,
+	// then build the index.
+	void beginraw(std::string_view name);
+	void appendraw(const char* data, std::size_t len)
+	{
+		checklength(true, arena.length() - tokstart + len);
+		arena.append(data, len);
+	}
+	void endraw();
+	void index();
+
+	// Parse id=val; id=val input.
+	void parsecookies(std::string_view cookielist);
+
+	// Find the group for a name, or 0 if there is none.
+	group* find(std::string_view name);
+	const group* find(std::string_view name) const;
+
+	// Get the decoded value of an entry.
+	std::string_view value(entry& e)
+	{
+		if (!e.decoded) {
+			e.value = decode(e.value.offset, e.value.length);
+			e.decoded = true;
+			views[&e - entries.data()] = str(e.value);
+		}
+		return str(e.value);
+	}
+
+	// Get the decoded values of a group, in arrival order.
+	const std::string_view* values(const group& g)
+	{
+		for (std::size_t i = g.first; i != g.first + g.count; ++i)
+			value(entries[i]);
+		return views.data() + g.first;
+	}
+
+	std::string_view str(const span& s) const
+	{ return std::string_view(arena.data() + s.offset, s.length); }
+
+	// Number of values of g not yet consumed.
+	static std::size_t remaining(const group& g)
+	{ return g.count - g.next; }
+
+	// Throw cgiexception if a name or value of len bytes, as sent, or
+	// one more entry would exceed the limits.
+	void checklength(bool value, std::size_t len) const
+	{
+		if (value ? maxvalue && len > maxvalue : maxname && len > maxname)
+			toolong(value);
+	}
+	void checkcount(std::size_t count) const
+	{
+		if (maxentries && count >= maxentries)
+			toomany();
+	}
+
+	bool lazy;
+	const char* kind;	// "parameter" or "cookie", for errors
+	std::size_t maxentries;	// limits, or 0 for none
+	std::size_t maxname;
+	std::size_t maxvalue;
+	std::pmr::string arena;
+	std::pmr::vector<entry> entries;
+	std::pmr::vector<group> groups;
+	std::pmr::vector<std::string_view> views;	// value of each entry
+
+private:
+	// A slot of the hash index over groups.
+	struct slot {
+		std::uint32_t hash;	// high bits of the name's hash
+		std::uint32_t group;	// index of group + 1, or 0 if empty
+	};
+
+	std::pmr::vector<slot> slots;	// open addressing, linear probing
+	std::size_t mask;		// slots.size() - 1
+
+	span decode(std::size_t offset, std::size_t length);
+	void add(const span& name, std::size_t offset, std::size_t length,
+		bool escaped = true);
+	void endvalue();
+	void buildslots();
+	[[noreturn]] void toolong(bool value) const;
+	[[noreturn]] void toomany() const;
+
+	// Incremental parser state.
+	bool invalue;		// reading a value rather than a name
+	bool sawequals;		// input is not an ISINDEX query
+	std::size_t tokstart;	// arena offset of the token being read
+	span pending;		// name of the value being read
+};
+
+} // end namespace cgixx
+
+#endif // __cgixx_paramlist_h
@@ -0,0 +1,125 @@
+/*
+ * pmralloc.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_pmralloc_h
+#define __cgixx_pmralloc_h
+
+#include <memory_resource>
+#include <new>
+#include <cstddef>
+#include <utility>
+
+namespace cgixx {
+
+/*
+ * Construct an object in memory from a memory resource, as C++20's
+ * polymorphic_allocator::new_object does.  Used for the pimpls, so that
+ * everything a cgi, header or cookie allocates comes from the resource
+ * it was given.
+ */
+template <typename T, typename... A>
+T* newobject(std::pmr::memory_resource* resource, A&&... args)
+{
+	void* p = resource->allocate(sizeof(T), alignof(T));
+	try {
+		return new (p) T(std::forward<A>(args)...);
+	} catch (...) {
+		resource->deallocate(p, sizeof(T), alignof(T));
+		throw;
+	}
+}
+
+/*
+ * Destroy an object made by newobject and return its memory.
+ */
+template <typename T>
+void deleteobject(std::pmr::memory_resource* resource, T* p)
+{
+	if (p) {
+		p->~T();
+		resource->deallocate(p, sizeof(T), alignof(T));
+	}
+}
+
+/*
+ * The resource to use for a pointer that may be 0.
+ */
+inline std::pmr::memory_resource* resourceor(std::pmr::memory_resource* r)
+{
+	return r ? r : std::pmr::get_default_resource();
+}
+
+/*
+ * Construct a pimpl in the inline storage of its owner when it fits, or
+ * else from the resource, so that most objects need no allocation of
+ * their own and can be moved by moving their members.
+ */
+template <typename T, std::size_t N, typename... A>
+T* makeimpl(unsigned char (&storage)[N], std::pmr::memory_resource* resource,
+	A&&... args)
+{
+	if constexpr (sizeof(T) <= N && alignof(T) <= alignof(std::max_align_t))
+		return new (storage) T(std::forward<A>(args)...);
+	else
+		return newobject<T>(resource, std::forward<A>(args)...);
+}
+
+/*
+ * Check whether a pimpl lives in the inline storage of its owner.
+ */
+template <typename T, std::size_t N>
+bool isinline(const unsigned char (&storage)[N], const T* p)
+{
+	return static_cast<const void*>(p) == storage;
+}
+
+/*
+ * Destroy a pimpl made by makeimpl.  T records its resource.
+ */
+template <typename T, std::size_t N>
+void destroyimpl(const unsigned char (&storage)[N], T* p)
+{
+	if (isinline(storage, p))
+		p->~T();
+	else if (p)
+		deleteobject(p->resource, p);
+}
+
+} // end namespace cgixx
+
+#endif // __cgixx_pmralloc_h
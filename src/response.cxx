@@ -0,0 +1,482 @@
+/*
+ * response.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "compat.h"
+
+#include "pmralloc.h"
+#include <cgixx/response.h>
+#include <streambuf>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <cstring>
+#include <climits>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace cgixx {
+
+namespace {
+
+// First allocation for a body.
+const std::size_t initialsize = 4096;
+
+// Bodies at least this large are kept in memory mapped pages.
+const std::size_t mapsize = 1 << 20;
+
+// Size of the blocks sent while streaming.
+const std::size_t streamsize = 65536;
+
+/*
+ * Write all of a buffer, resuming after partial writes and signals.
+ */
+bool writeall(int fd, const char* p, std::size_t left)
+{
+	while (left)
+	{
+#ifdef _WIN32
+		int n = ::_write(fd, p, unsigned(left < INT_MAX ? left : INT_MAX));
+#else
+		ssize_t n = ::write(fd, p, left);
+		if (n < 0 && errno == EINTR)
+			continue;
+#endif
+		if (n <= 0)
+			return true;
+		p+= n;
+		left-= n;
+	}
+	return false;
+}
+
+/*
+ * Stream buffer whose put area is the body of the response.  While
+ * buffering it grows to hold the whole body; while streaming it sends
+ * its contents to the sink each time it fills.
+ */
+class responsebuf : public std::streambuf {
+public:
+	responsebuf(std::pmr::memory_resource* r, int f, std::ostream* s)
+		: resource(r), fd(f), sink(s), base(0), capacity(0),
+		mapped(false), streaming(false), failed(false)
+	{
+	}
+
+	~responsebuf()
+	{
+		release();
+	}
+
+	const char* data() const { return pbase(); }
+	std::size_t size() const { return pptr() - pbase(); }
+
+	// Send data to the sink.  Returns true on error.
+	bool send(const char* p, std::size_t n)
+	{
+		if (failed || !n)
+			return failed;
+		if (sink)
+			failed = !sink->write(p, n);
+		else
+			failed = writeall(fd, p, n);
+		return failed;
+	}
+
+	// Send and discard the buffered data.  Returns true on error.
+	bool flushbuf()
+	{
+		send(pbase(), size());
+		clear();
+		if (sink && !failed)
+			failed = !sink->flush();
+		return failed;
+	}
+
+	// Discard the buffered data.
+	void clear()
+	{
+		setp(base, base + capacity);
+	}
+
+	// Send the buffered data as it fills from now on.
+	void startstreaming()
+	{
+		streaming = true;
+		if (capacity < streamsize)
+			grow(streamsize);
+	}
+
+	bool hasfailed() const { return failed; }
+
+protected:
+	int_type overflow(int_type c)
+	{
+		if (traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+		char ch = traits_type::to_char_type(c);
+		return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+	}
+
+	std::streamsize xsputn(const char* s, std::streamsize count)
+	{
+		std::size_t n = count;
+		if (std::size_t(epptr() - pptr()) < n)
+		{
+			if (!streaming)
+				grow(size() + n);
+			else
+			{
+				flushbuf();
+				// Send large blocks without copying them.
+				if (n >= capacity)
+					return send(s, n) ? 0 : count;
+			}
+		}
+		std::memcpy(pptr(), s, n);
+		advance(n);
+		return count;
+	}
+
+	int sync()
+	{
+		return streaming && flushbuf() ? -1 : 0;
+	}
+
+private:
+	/*
+	 * Make room for at least need bytes, doubling the capacity.  Large
+	 * buffers are mapped, and on Linux grown with mremap so the pages
+	 * are moved rather than copied.
+	 */
+	void grow(std::size_t need)
+	{
+		std::size_t used = size();
+		std::size_t want = std::max(std::max(need, capacity * 2), initialsize);
+		char* p = 0;
+		bool map = false;
+		bool moved = false;
+#ifndef _WIN32
+		if (want >= mapsize)
+		{
+			std::size_t page = ::sysconf(_SC_PAGESIZE);
+			want = (want + page - 1) / page * page;
+			void* m;
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+			if (mapped)
+			{
+				m = ::mremap(base, capacity, want, MREMAP_MAYMOVE);
+				moved = true;
+			}
+			else
+#endif
+				m = ::mmap(0, want, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (m == MAP_FAILED)
+				throw std::bad_alloc();
+			p = static_cast<char*>(m);
+			map = true;
+		}
+#endif
+		if (!p)
+			p = static_cast<char*>(resource->allocate(want,
+				alignof(std::max_align_t)));
+		if (!moved)
+		{
+			if (used)
+				std::memcpy(p, base, used);
+			release();
+		}
+		base = p;
+		capacity = want;
+		mapped = map;
+		setp(base, base + capacity);
+		advance(used);
+	}
+
+	// pbump takes an int, so move past larger counts in steps.
+	void advance(std::size_t n)
+	{
+		for (; n > INT_MAX; n-= INT_MAX)
+			pbump(INT_MAX);
+		pbump(int(n));
+	}
+
+	void release()
+	{
+		if (!base)
+			return;
+#ifndef _WIN32
+		if (mapped)
+			::munmap(base, capacity);
+		else
+#endif
+			resource->deallocate(base, capacity, alignof(std::max_align_t));
+		base = 0;
+	}
+
+	std::pmr::memory_resource* resource;
+	int fd;
+	std::ostream* sink;
+	char* base;
+	std::size_t capacity;
+	bool mapped;
+	bool streaming;
+	bool failed;
+};
+
+} // end anonymous namespace
+
+
+struct response_impl
+{
+	std::pmr::memory_resource* resource;
+	header head;
+	const frozenheader* frozen;
+	headerpatch patch;
+	int fd;
+	std::ostream* sink;
+	responsebuf body;
+	std::ostream bodystream;
+	bool streaming;
+	bool finished;
+
+	response_impl(std::pmr::memory_resource* r, int f, std::ostream* s)
+		: resource(r), head(r), frozen(0), fd(f), sink(s), body(r, f, s),
+		bodystream(&body), streaming(false), finished(false) {}
+
+	bool sendhead(bool setlength);
+};
+
+
+/*
+ * Send the header and the buffered body, with the length of the body as
+ * the Content-length if setlength.  Returns true on error.
+ */
+bool response_impl::sendhead(bool setlength)
+{
+	std::size_t n = body.size();
+	// Content-length is unsigned, so longer bodies are sent without one.
+	// An empty body is sent with a length of 0.
+	bool fits = n <= UINT_MAX;
+	if (frozen)
+	{
+		if (setlength)
+		{
+			patch.length = fits ? unsigned(n) : 0;
+			patch.haslength = fits;
+		}
+		if (!sink)
+			return frozen->write(fd, patch, body.data(), n);
+		std::string text(frozen->get(patch));
+		return body.send(text.data(), text.length()) || body.flushbuf();
+	}
+	if (setlength)
+		head.setlength(fits ? unsigned(n) : 0, fits);
+	if (!sink)
+		return head.write(fd, body.data(), n);
+	std::string text(head.get());
+	return body.send(text.data(), text.length()) || body.flushbuf();
+}
+
+
+/**
+ * Construct a response that is sent to a file descriptor.
+ *
+ * @param	fd			The descriptor to send to, by default 1 (standard
+ *						output).  Anything buffered in std::cout or
+ *						stdout must be flushed before it is sent.
+ * @param	resource	The memory resource for the header and small
+ *						bodies, or 0 for the default resource.
+ */
+response::response(int fd, std::pmr::memory_resource* resource)
+	: imp(newobject<response_impl>(resourceor(resource), resourceor(resource),
+		fd, static_cast<std::ostream*>(0)))
+{
+}
+
+
+/**
+ * Construct a response that is sent to an output stream, such as the
+ * out() stream of an fcgi_request.  The header and body are written as
+ * two blocks, since there is no writev for a stream.
+ *
+ * @param	sink		The stream to send to.
+ * @param	resource	The memory resource for the header and small
+ *						bodies, or 0 for the default resource.
+ */
+response::response(std::ostream& sink, std::pmr::memory_resource* resource)
+	: imp(newobject<response_impl>(resourceor(resource), resourceor(resource),
+		-1, &sink))
+{
+}
+
+
+/**
+ * Destroy *this response.  The rest of a streaming body is sent; a
+ * buffered response that was never finished is discarded.
+ */
+response::~response()
+{
+	if (imp->streaming)
+		finish();
+	deleteobject(imp->resource, imp);
+}
+
+
+/**
+ * Get the header to send with the response.  Its Content-length is set
+ * when the response is finished, unless it is streaming.
+ *
+ * @return	The header.
+ */
+header& response::gethead()
+{
+	return imp->head;
+}
+
+
+/**
+ * Send a frozen header instead of gethead().  The Content-length of the
+ * patch is filled in when the response is finished, unless it is
+ * streaming.
+ *
+ * @param	frozen		The header, which must outlive *this response.
+ * @param	patch		The per-response parts of the header.  Any cookies
+ *						it points to must outlive *this response.
+ */
+void response::usefrozen(const frozenheader& frozen, const headerpatch& patch)
+{
+	imp->frozen = &frozen;
+	imp->patch = patch;
+}
+
+
+/**
+ * Append text to the body.  While streaming, the body is sent each time
+ * a block fills.
+ *
+ * @param	text		The text to append.
+ * @param	length		The length of the text.
+ */
+void response::write(const char* text, std::size_t length)
+{
+	imp->body.sputn(text, length);
+}
+
+
+/**
+ * Append text to the body.  While streaming, the body is sent each time
+ * a block fills.
+ *
+ * @param	text		The text to append.
+ */
+void response::write(std::string_view text)
+{
+	imp->body.sputn(text.data(), text.length());
+}
+
+
+/**
+ * Get a stream that appends to the body, for formatted output.
+ *
+ * @return	The stream.
+ */
+std::ostream& response::out()
+{
+	return imp->bodystream;
+}
+
+
+/**
+ * Get the number of bytes of the body that have been buffered but not
+ * yet sent.  Until the response streams, this is the length of the body.
+ *
+ * @return	The number of bytes.
+ */
+std::size_t response::length() const
+{
+	return imp->body.size();
+}
+
+
+/**
+ * Send the header and what has been written of the body now, and send
+ * the rest of the body in blocks as it is written, for bodies too large
+ * to buffer.  The Content-length is only sent if it was set on the
+ * header or patch.
+ *
+ * @return	false on success; true if a write failed.
+ */
+bool response::stream()
+{
+	if (imp->streaming || imp->finished)
+		return imp->body.hasfailed();
+	imp->streaming = true;
+	bool failed = imp->sendhead(false);
+	imp->body.clear();
+	imp->body.startstreaming();
+	return failed || imp->body.hasfailed();
+}
+
+
+/**
+ * Send the response.  A buffered body is sent with its header, and the
+ * Content-length set to its length, in a single write.  A streaming body
+ * has its last block sent.  Once finished, nothing more is sent.
+ *
+ * @return	false on success; true if any write failed.
+ */
+bool response::finish()
+{
+	if (imp->finished)
+		return imp->body.hasfailed();
+	imp->finished = true;
+	bool failed;
+	if (imp->streaming)
+		failed = imp->body.flushbuf();
+	else
+		failed = imp->sendhead(true);
+	return failed || imp->body.hasfailed();
+}
+
+} // end namespace cgixx
@@ -0,0 +1,128 @@
+/*
+ * siphash.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "siphash.h"
+#include <random>
+#include <chrono>
+#include <cstring>
+
+namespace cgixx {
+
+namespace {
+
+inline std::uint64_t rotl(std::uint64_t x, int b)
+{
+	return (x << b) | (x >> (64 - b));
+}
+
+inline void sipround(std::uint64_t& v0, std::uint64_t& v1,
+	std::uint64_t& v2, std::uint64_t& v3)
+{
+	v0+= v1; v1 = rotl(v1, 13); v1^= v0; v0 = rotl(v0, 32);
+	v2+= v3; v3 = rotl(v3, 16); v3^= v2;
+	v0+= v3; v3 = rotl(v3, 21); v3^= v0;
+	v2+= v1; v1 = rotl(v1, 17); v1^= v2; v2 = rotl(v2, 32);
+}
+
+// Read 8 bytes as a little-endian word.
+inline std::uint64_t load64(const unsigned char* p)
+{
+	std::uint64_t v = 0;
+	for (int i = 7; i >= 0; --i)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+sipkey makekey()
+{
+	sipkey key;
+	try {
+		std::random_device rd;
+		key.k0 = (std::uint64_t(rd()) << 32) | rd();
+		key.k1 = (std::uint64_t(rd()) << 32) | rd();
+	} catch (...) {
+		// No entropy source; fall back to the clock and an address.
+		key.k0 = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		key.k1 = reinterpret_cast<std::uintptr_t>(&key) ^ rotl(key.k0, 29);
+	}
+	return key;
+}
+
+} // end anonymous namespace
+
+
+std::uint64_t siphash(const void* data, std::size_t len, const sipkey& key)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	const unsigned char* end = p + (len & ~std::size_t(7));
+	std::uint64_t v0 = key.k0 ^ 0x736f6d6570736575ULL;
+	std::uint64_t v1 = key.k1 ^ 0x646f72616e646f6dULL;
+	std::uint64_t v2 = key.k0 ^ 0x6c7967656e657261ULL;
+	std::uint64_t v3 = key.k1 ^ 0x7465646279746573ULL;
+
+	for (; p != end; p+= 8)
+	{
+		std::uint64_t m = load64(p);
+		v3^= m;
+		sipround(v0, v1, v2, v3);
+		v0^= m;
+	}
+
+	// The last block holds the remaining bytes and the length.
+	unsigned char last[8] = { 0 };
+	std::memcpy(last, p, len & 7);
+	std::uint64_t m = load64(last) | (std::uint64_t(len) << 56);
+	v3^= m;
+	sipround(v0, v1, v2, v3);
+	v0^= m;
+
+	v2^= 0xff;
+	sipround(v0, v1, v2, v3);
+	sipround(v0, v1, v2, v3);
+	sipround(v0, v1, v2, v3);
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+const sipkey& processkey()
+{
+	static const sipkey key(makekey());
+	return key;
+}
+
+} // end namespace cgixx
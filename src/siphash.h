@@ -1,5 +1,5 @@
 /*
- * timedefs.inl
+ * siphash.h
  *
  */
 
@@ -35,13 +35,29 @@
  *
  */
 
-#ifndef __timedefs_inl
-#define __timedefs_inl
 
-namespace {
-	const char* weekday[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
-	const char* month[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug",
-		"Sep", "Oct", "Nov", "Dec"};
-}
+#ifndef __cgixx_siphash_h
+#define __cgixx_siphash_h
 
-#endif // __timedefs_inl
+#include <cstdint>
+#include <cstddef>
+
+namespace cgixx {
+
+/*
+ * SipHash-1-3, a keyed hash that keeps an attacker who does not know the
+ * key from choosing names that collide.  Used to index request names.
+ */
+struct sipkey {
+	std::uint64_t k0;
+	std::uint64_t k1;
+};
+
+std::uint64_t siphash(const void* data, std::size_t len, const sipkey& key);
+
+// The key for this process, chosen at random on first use.
+const sipkey& processkey();
+
+} // end namespace cgixx
+
+#endif // __cgixx_siphash_h
@@ -0,0 +1,578 @@
+/*
+ * urlcodec.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Percent-decoding and encoding kernels.  The scalar, SSE2 and AVX2
+ * decoders share the same loop: find the next '%' or '+', copy the clean
+ * run before it in one block, then translate the escape.  The encoders
+ * likewise classify bytes a block at a time, first to count escapes so
+ * the output is sized exactly once, then to copy clean runs.  The best
+ * variant for the CPU is chosen the first time one is needed.
+ */
+
+#include "cgi_impl.h"
+#include "urlcodec.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define CGIXX_X86_SIMD
+#	include <immintrin.h>
+#endif
+
+namespace cgixx {
+
+namespace {
+
+/*
+ * Table of hex digit values.  Anything that is not a hex digit maps to
+ * c - '0', as cgixx always has, so malformed escapes decode the same.
+ */
+struct hextable {
+	unsigned char value[256];
+
+	constexpr hextable() : value()
+	{
+		for (int c = 0; c != 256; ++c)
+		{
+			if (c >= 'A' && c <= 'F')
+				value[c] = c - 'A' + 10;
+			else if (c >= 'a' && c <= 'f')
+				value[c] = c - 'a' + 10;
+			else
+				value[c] = (c - '0') & 0xff;
+		}
+	}
+};
+
+constexpr hextable hexdigits;
+
+/*
+ * Translate the escape or '+' at *in.  Returns false if the input ends
+ * inside an escape, which ends decoding.
+ */
+inline bool decodeone(char*& out, const char*& in, const char* end)
+{
+	if (*in == '+')
+	{
+		*out++ = ' ';
+		++in;
+		return true;
+	}
+	if (end - in < 3)
+		return false;
+	*out++ = static_cast<char>(
+		(hexdigits.value[static_cast<unsigned char>(in[1])] << 4) +
+		hexdigits.value[static_cast<unsigned char>(in[2])]);
+	in+= 3;
+	return true;
+}
+
+/*
+ * Copy a clean run.  When decoding in place the output trails the input,
+ * so the two may overlap.
+ */
+inline void copyrun(char*& out, const char* in, std::size_t len)
+{
+	if (out != in)
+		std::memmove(out, in, len);
+	out+= len;
+}
+
+std::size_t decode_scalar(char* dst, const char* src, std::size_t len)
+{
+	const char* in = src;
+	const char* end = src + len;
+	char* out = dst;
+
+	while (in != end)
+	{
+		const char* p = in;
+		while (p != end && *p != '%' && *p != '+')
+			++p;
+		copyrun(out, in, p - in);
+		in = p;
+		if (in == end || !decodeone(out, in, end))
+			break;
+	}
+	return out - dst;
+}
+
+#ifdef CGIXX_X86_SIMD
+
+__attribute__((target("sse2")))
+std::size_t decode_sse2(char* dst, const char* src, std::size_t len)
+{
+	const char* in = src;
+	const char* end = src + len;
+	char* out = dst;
+	const __m128i pct = _mm_set1_epi8('%');
+	const __m128i plus = _mm_set1_epi8('+');
+
+	while (in != end)
+	{
+		const char* p = in;
+		for (;;)
+		{
+			if (end - p < 16)
+			{
+				while (p != end && *p != '%' && *p != '+')
+					++p;
+				break;
+			}
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			unsigned mask = _mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(v, pct), _mm_cmpeq_epi8(v, plus)));
+			if (mask)
+			{
+				p+= __builtin_ctz(mask);
+				break;
+			}
+			p+= 16;
+		}
+		copyrun(out, in, p - in);
+		in = p;
+		if (in == end || !decodeone(out, in, end))
+			break;
+	}
+	return out - dst;
+}
+
+__attribute__((target("avx2")))
+std::size_t decode_avx2(char* dst, const char* src, std::size_t len)
+{
+	const char* in = src;
+	const char* end = src + len;
+	char* out = dst;
+	const __m256i pct = _mm256_set1_epi8('%');
+	const __m256i plus = _mm256_set1_epi8('+');
+
+	while (in != end)
+	{
+		const char* p = in;
+		for (;;)
+		{
+			if (end - p < 32)
+			{
+				while (p != end && *p != '%' && *p != '+')
+					++p;
+				break;
+			}
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(
+				_mm256_cmpeq_epi8(v, pct), _mm256_cmpeq_epi8(v, plus)));
+			if (mask)
+			{
+				p+= __builtin_ctz(mask);
+				break;
+			}
+			p+= 32;
+		}
+		copyrun(out, in, p - in);
+		in = p;
+		if (in == end || !decodeone(out, in, end))
+			break;
+	}
+	return out - dst;
+}
+
+#endif // CGIXX_X86_SIMD
+
+typedef std::size_t (*decodefunc)(char*, const char*, std::size_t);
+
+decodefunc selectdecoder()
+{
+#ifdef CGIXX_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return decode_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return decode_sse2;
+#endif
+	return decode_scalar;
+}
+
+/*
+ * Encoding classes.  Clean bytes are copied as is; in a safe string a
+ * space becomes '+'; everything else becomes a %XX escape.  Only ASCII
+ * letters and digits are clean, as std::isalnum reports in the C locale.
+ */
+enum {
+	enc_clean = 0,
+	enc_plus,
+	enc_escape
+};
+
+struct enctable {
+	unsigned char cls[256];
+
+	constexpr enctable(bool safe) : cls()
+	{
+		for (int c = 0; c != 256; ++c)
+		{
+			if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+				(c >= 'a' && c <= 'z') || (safe && c == '_'))
+				cls[c] = enc_clean;
+			else if (safe && c == ' ')
+				cls[c] = enc_plus;
+			else
+				cls[c] = enc_escape;
+		}
+	}
+};
+
+constexpr enctable cgitable(false);
+constexpr enctable safetable(true);
+
+const char hexchars[] = "0123456789ABCDEF";
+
+/*
+ * Write the output for a byte that is not clean.
+ */
+inline void encodeone(char*& out, unsigned char c, const enctable& table)
+{
+	if (table.cls[c] == enc_plus)
+		*out++ = '+';
+	else
+	{
+		out[0] = '%';
+		out[1] = hexchars[c >> 4];
+		out[2] = hexchars[c & 15];
+		out+= 3;
+	}
+}
+
+void encode_scalar(const char* in, std::size_t len, std::string& out,
+	bool safe)
+{
+	const enctable& table = safe ? safetable : cgitable;
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+	const unsigned char* end = p + len;
+
+	std::size_t escapes = 0;
+	for (; p != end; ++p)
+		escapes+= table.cls[*p] == enc_escape;
+
+	std::size_t start = out.length();
+	out.resize(start + len + 2 * escapes);
+	char* o = &out[start];
+	for (p = reinterpret_cast<const unsigned char*>(in); p != end; ++p)
+	{
+		if (table.cls[*p] == enc_clean)
+			*o++ = *p;
+		else
+			encodeone(o, *p, table);
+	}
+}
+
+#ifdef CGIXX_X86_SIMD
+
+/*
+ * Mask of the clean bytes in a block.  Unsigned range checks use min:
+ * x <= k exactly when min(x, k) == x.
+ */
+__attribute__((target("sse2")))
+inline __m128i cleanmask_sse2(__m128i v, bool safe)
+{
+	__m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+	__m128i a = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+		_mm_set1_epi8('a'));
+	__m128i clean = _mm_or_si128(
+		_mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d),
+		_mm_cmpeq_epi8(_mm_min_epu8(a, _mm_set1_epi8(25)), a));
+	if (safe)
+		clean = _mm_or_si128(clean, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+	return clean;
+}
+
+__attribute__((target("sse2")))
+void encode_sse2(const char* in, std::size_t len, std::string& out,
+	bool safe)
+{
+	const enctable& table = safe ? safetable : cgitable;
+	const char* end = in + len;
+	const char* p = in;
+
+	std::size_t escapes = 0;
+	for (; end - p >= 16; p+= 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i keep = cleanmask_sse2(v, safe);
+		if (safe)
+			keep = _mm_or_si128(keep, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+		escapes+= __builtin_popcount(~_mm_movemask_epi8(keep) & 0xffff);
+	}
+	for (; p != end; ++p)
+		escapes+= table.cls[static_cast<unsigned char>(*p)] == enc_escape;
+
+	std::size_t start = out.length();
+	out.resize(start + len + 2 * escapes);
+	char* o = &out[start];
+	while (in != end)
+	{
+		p = in;
+		for (;;)
+		{
+			if (end - p < 16)
+			{
+				while (p != end &&
+					table.cls[static_cast<unsigned char>(*p)] == enc_clean)
+					++p;
+				break;
+			}
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			unsigned mask = ~_mm_movemask_epi8(cleanmask_sse2(v, safe)) & 0xffff;
+			if (mask)
+			{
+				p+= __builtin_ctz(mask);
+				break;
+			}
+			p+= 16;
+		}
+		std::memcpy(o, in, p - in);
+		o+= p - in;
+		in = p;
+		if (in == end)
+			break;
+		encodeone(o, static_cast<unsigned char>(*in++), table);
+	}
+}
+
+__attribute__((target("avx2")))
+inline __m256i cleanmask_avx2(__m256i v, bool safe)
+{
+	__m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+	__m256i a = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+		_mm256_set1_epi8('a'));
+	__m256i clean = _mm256_or_si256(
+		_mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d),
+		_mm256_cmpeq_epi8(_mm256_min_epu8(a, _mm256_set1_epi8(25)), a));
+	if (safe)
+		clean = _mm256_or_si256(clean,
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+	return clean;
+}
+
+__attribute__((target("avx2")))
+void encode_avx2(const char* in, std::size_t len, std::string& out,
+	bool safe)
+{
+	const enctable& table = safe ? safetable : cgitable;
+	const char* end = in + len;
+	const char* p = in;
+
+	std::size_t escapes = 0;
+	for (; end - p >= 32; p+= 32)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i keep = cleanmask_avx2(v, safe);
+		if (safe)
+			keep = _mm256_or_si256(keep,
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+		escapes+= __builtin_popcount(~_mm256_movemask_epi8(keep));
+	}
+	for (; p != end; ++p)
+		escapes+= table.cls[static_cast<unsigned char>(*p)] == enc_escape;
+
+	std::size_t start = out.length();
+	out.resize(start + len + 2 * escapes);
+	char* o = &out[start];
+	while (in != end)
+	{
+		p = in;
+		for (;;)
+		{
+			if (end - p < 32)
+			{
+				while (p != end &&
+					table.cls[static_cast<unsigned char>(*p)] == enc_clean)
+					++p;
+				break;
+			}
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			unsigned mask = ~_mm256_movemask_epi8(cleanmask_avx2(v, safe));
+			if (mask)
+			{
+				p+= __builtin_ctz(mask);
+				break;
+			}
+			p+= 32;
+		}
+		std::memcpy(o, in, p - in);
+		o+= p - in;
+		in = p;
+		if (in == end)
+			break;
+		encodeone(o, static_cast<unsigned char>(*in++), table);
+	}
+}
+
+#endif // CGIXX_X86_SIMD
+
+typedef void (*encodefunc)(const char*, std::size_t, std::string&, bool);
+
+encodefunc selectencoder()
+{
+#ifdef CGIXX_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return encode_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return encode_sse2;
+#endif
+	return encode_scalar;
+}
+
+void encode(std::string_view text, std::string& out, bool safe)
+{
+	static const encodefunc encoder = selectencoder();
+	encoder(text.data(), text.length(), out, safe);
+}
+
+} // end anonymous namespace
+
+
+/*
+ * Decode a cgi string in place.  The decoded text is never longer than
+ * the input.  Returns the length of the decoded text.
+ *
+ */
+std::size_t cgi2text(char* buf, std::size_t len)
+{
+	static const decodefunc decode = selectdecoder();
+	return decode(buf, buf, len);
+}
+
+
+/*
+ * Decode a cgi string in place with a given variant.  Returns false on
+ * success, or true if the variant is not available.
+ */
+bool cgi2textwith(codecvariant variant, char* buf, std::size_t len,
+	std::size_t& outlen)
+{
+	decodefunc decode = 0;
+	switch (variant)
+	{
+	case codec_variant_scalar:
+		decode = decode_scalar;
+		break;
+#ifdef CGIXX_X86_SIMD
+	case codec_variant_sse2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2"))
+			decode = decode_sse2;
+		break;
+	case codec_variant_avx2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			decode = decode_avx2;
+		break;
+#endif
+	default:
+		break;
+	}
+	if (!decode)
+		return true;
+	outlen = decode(buf, buf, len);
+	return false;
+}
+
+
+/*
+ * Append the encoding of a string with a given variant.  Returns false
+ * on success, or true if the variant is not available.
+ */
+bool encodewith(codecvariant variant, std::string_view text,
+	std::string& out, bool safe)
+{
+	encodefunc encoder = 0;
+	switch (variant)
+	{
+	case codec_variant_scalar:
+		encoder = encode_scalar;
+		break;
+#ifdef CGIXX_X86_SIMD
+	case codec_variant_sse2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2"))
+			encoder = encode_sse2;
+		break;
+	case codec_variant_avx2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			encoder = encode_avx2;
+		break;
+#endif
+	default:
+		break;
+	}
+	if (!encoder)
+		return true;
+	encoder(text.data(), text.length(), out, safe);
+	return false;
+}
+
+
+/*
+ * Append the cgi encoding of a string to cgistr.  All characters except
+ * letters and digits are converted to %hex notation.
+ *
+ */
+std::string& text2cgi(std::string_view textstr, std::string& cgistr)
+{
+	encode(textstr, cgistr, false);
+	return cgistr;
+}
+
+
+/**
+ * Append a string converted for use in a URL to outstr.  All characters
+ * except letters, digits and '_' are converted to %hex notation, and
+ * spaces to '+'.  The output is sized once, so appending many strings to
+ * one buffer avoids temporary strings.
+ *
+ * @param   instr       Input string
+ * @param   outstr      Output string to append to
+ * @return  Reference to outstr.
+ */
+std::string& appendsafestring(std::string_view instr, std::string& outstr)
+{
+	encode(instr, outstr, true);
+	return outstr;
+}
+
+} // end namespace cgixx
@@ -0,0 +1,79 @@
+/*
+ * urlcodec.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __cgixx_urlcodec_h
+#define __cgixx_urlcodec_h
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+namespace cgixx {
+
+/*
+ * The percent-decoders and encoders compiled into cgixx.  cgi2text,
+ * text2cgi and appendsafestring pick the best one the CPU supports;
+ * cgi2textwith and encodewith run a given one, so that tests can check
+ * that every variant gives the same result.
+ */
+enum codecvariant {
+	codec_variant_scalar,
+	codec_variant_sse2,
+	codec_variant_avx2
+};
+
+/*
+ * Decode a cgi string in place with a given variant, setting outlen to
+ * the length of the decoded text.  Returns false on success, or true if
+ * the variant is not compiled in or not supported by this CPU.
+ */
+bool cgi2textwith(codecvariant variant, char* buf, std::size_t len,
+	std::size_t& outlen);
+
+/*
+ * Append the encoding of text to out with a given variant, as
+ * appendsafestring does if safe, or else as text2cgi does.  Returns false
+ * on success, or true if the variant is not compiled in or not supported
+ * by this CPU.
+ */
+bool encodewith(codecvariant variant, std::string_view text,
+	std::string& out, bool safe);
+
+} // end namespace cgixx
+
+#endif // __cgixx_urlcodec_h
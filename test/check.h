@@ -0,0 +1,163 @@
+/*
+ * check.h
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Shared scaffolding for the standalone tests.  A test program includes
+ * this header once, defines test(), and reports each case with check.
+ * main exits non-zero if any check failed or test() threw.
+ */
+
+#ifndef __cgixx_test_check_h
+#define __cgixx_test_check_h
+
+#include <cgixx/cgi.h>
+#include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <unistd.h>
+
+// Run the cases of a test program.
+void test();
+
+// Number of failed checks.
+inline int failures = 0;
+
+// Report one case.
+inline void check(bool ok, const std::string& what)
+{
+	std::cout << (ok ? "ok: " : "FAILED: ") << what << std::endl;
+	if (!ok)
+		++failures;
+}
+
+// Environment of a GET request with a query string.
+inline cgixx::cgi::environment queryenv(const std::string& query)
+{
+	cgixx::cgi::environment env;
+	env["REQUEST_METHOD"] = "GET";
+	env["QUERY_STRING"] = query;
+	return env;
+}
+
+// Environment of a POST request whose body is of type.
+inline cgixx::cgi::environment postenv(const std::string& type,
+	const std::string& body)
+{
+	cgixx::cgi::environment env;
+	env["REQUEST_METHOD"] = "POST";
+	env["CONTENT_TYPE"] = type;
+	env["CONTENT_LENGTH"] = std::to_string(body.length());
+	return env;
+}
+
+// Read back and empty a temporary file.
+inline std::string drain(std::FILE* f)
+{
+	std::string text;
+	char buf[65536];
+	std::size_t n;
+	std::rewind(f);
+	while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+		text.append(buf, n);
+	std::rewind(f);
+	if (::ftruncate(fileno(f), 0))
+		throw std::runtime_error("ftruncate failed");
+	return text;
+}
+
+// Strip the Date line of a response header, which changes every second.
+inline std::string nodate(std::string text)
+{
+	std::string::size_type at = text.find("Date: ");
+	if (at != std::string::npos)
+		text.erase(at, text.find("\r\n", at) + 2 - at);
+	return text;
+}
+
+// A memory resource that counts what is taken from it and passes the
+// requests on to upstream.
+struct countingresource : std::pmr::memory_resource {
+	explicit countingresource(std::pmr::memory_resource* up =
+		std::pmr::new_delete_resource()) : upstream(up), allocations(0),
+		live(0) {}
+
+	std::pmr::memory_resource* upstream;
+	unsigned long allocations;	// calls to allocate
+	long live;	// blocks not yet deallocated
+
+private:
+	void* do_allocate(std::size_t bytes, std::size_t align) override
+	{
+		void* p = upstream->allocate(bytes, align);
+		++allocations;
+		++live;
+		return p;
+	}
+
+	void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+	{
+		upstream->deallocate(p, bytes, align);
+		--live;
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const
+		noexcept override
+	{ return this == &other; }
+};
+
+int main()
+{
+	try {
+		test();
+	} catch(const std::exception& e) {
+		std::cerr << "EXCEPTION: " << e.what() << std::endl;
+		return 1;
+	} catch(...) {
+		std::cerr << "UNKNOWN EXCEPTION" << std::endl;
+		return 1;
+	}
+
+	if (failures) {
+		std::cerr << failures << " checks failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+#endif // __cgixx_test_check_h
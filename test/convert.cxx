@@ -0,0 +1,127 @@
+/*
+ * convert.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Convert values with convertvalue and the typed cgi::get, including
+ * empty, signed, out of range and non-finite values.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <string>
+#include <climits>
+
+// Check that raw converts with the expected error and value, and that a
+// failed conversion leaves the value unchanged.
+template <typename T>
+bool converts(const char* raw, cgixx::geterrors expected, T expectedvalue)
+{
+	T value = expectedvalue;
+	if (expected != cgixx::get_ok)
+		value = T(7);
+	cgixx::geterrors e = cgixx::convertvalue(raw, value);
+	return e == expected &&
+		value == (expected == cgixx::get_ok ? expectedvalue : T(7));
+}
+
+// The types cgi::get converts to, and arithmetic types it rejects.
+static_assert(cgixx::isconvertible<bool>::value &&
+	cgixx::isconvertible<unsigned short>::value &&
+	cgixx::isconvertible<unsigned long long>::value &&
+	cgixx::isconvertible<long double>::value, "supported types");
+static_assert(!cgixx::isconvertible<char>::value &&
+	!cgixx::isconvertible<signed char>::value &&
+	!cgixx::isconvertible<unsigned char>::value &&
+	!cgixx::isconvertible<wchar_t>::value &&
+	!cgixx::isconvertible<char16_t>::value &&
+	!cgixx::isconvertible<const int>::value, "unsupported types");
+
+void test()
+{
+	int i = 7;
+	check(cgixx::convertvalue(std::string_view(), i) == cgixx::get_invalid &&
+		i == 7, "empty view");
+	check(converts("", cgixx::get_invalid, 0), "empty int");
+	check(converts("", cgixx::get_invalid, 0.0), "empty double");
+	check(converts("+5", cgixx::get_ok, 5), "leading plus");
+	check(converts("-5", cgixx::get_ok, -5), "negative");
+	check(converts("+-5", cgixx::get_invalid, 0), "plus minus");
+	check(converts("+", cgixx::get_invalid, 0), "lone plus");
+	check(converts("5x", cgixx::get_invalid, 0), "trailing text");
+	check(converts(" 5", cgixx::get_invalid, 0), "leading space");
+	check(converts("-1", cgixx::get_invalid, 0u), "negative unsigned");
+	check(converts("2147483648", cgixx::get_range, 0), "int overflow");
+	check(converts("-2147483649", cgixx::get_range, 0), "int underflow");
+	check(converts("65536", cgixx::get_range, (unsigned short)0),
+		"unsigned short overflow");
+	check(converts("18446744073709551615", cgixx::get_ok, ULLONG_MAX),
+		"largest unsigned long long");
+	check(converts("+1.5e2", cgixx::get_ok, 150.0), "double");
+	check(converts("1e999", cgixx::get_range, 0.0), "double overflow");
+	check(converts("inf", cgixx::get_invalid, 0.0), "inf");
+	check(converts("-inf", cgixx::get_invalid, 0.0), "negative inf");
+	check(converts("nan", cgixx::get_invalid, 0.0f), "nan");
+	check(converts("NaN", cgixx::get_invalid, 0.0), "NaN");
+
+	const char* const yes[] = { "1", "true", "TRUE", "on", "On", "yes" };
+	const char* const no[] = { "0", "false", "off", "no", "NO" };
+	bool allwords = true;
+	for (std::size_t k = 0; k < sizeof(yes) / sizeof(yes[0]); ++k)
+		allwords = converts(yes[k], cgixx::get_ok, true) && allwords;
+	for (std::size_t k = 0; k < sizeof(no) / sizeof(no[0]); ++k)
+		allwords = converts(no[k], cgixx::get_ok, false) && allwords;
+	check(allwords, "bool words");
+	check(converts("2", cgixx::get_invalid, false), "bool 2");
+	check(converts("y", cgixx::get_invalid, false), "bool y");
+	check(converts("", cgixx::get_invalid, false), "empty bool");
+
+	cgixx::cgi cgi(queryenv("n=%2B42&e=&big=99999999999&f=inf&b=on&n=x"),
+		std::string());
+	check(cgi.get<int>("n").value == 42 && !cgi.get<int>("n").failed(),
+		"get");
+	cgixx::getresult<int> r = cgi.get<int>("n", -1, 1);
+	check(r.value == -1 && r.error == cgixx::get_invalid, "get second value");
+	r = cgi.get<int>("e", -1);
+	check(r.value == -1 && r.error == cgixx::get_missing, "get empty");
+	r = cgi.get<int>("absent", 3);
+	check(r.value == 3 && r.error == cgixx::get_missing, "get missing");
+	r = cgi.get<int>("big", -1);
+	check(r.value == -1 && r.error == cgixx::get_range, "get out of range");
+	check(cgi.get<double>("f", 1.0).error == cgixx::get_invalid &&
+		cgi.get<double>("f", 1.0).value == 1.0, "get inf");
+	check(cgi.get<bool>("b").value, "get bool");
+}
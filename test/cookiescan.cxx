@@ -0,0 +1,186 @@
+/*
+ * cookiescan.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Classify cookie headers with every compiled variant and check the
+ * masks against the scalar classifier, then split headers longer than a
+ * block and look cookies up, with and without deferred parsing.
+ */
+
+#include "check.h"
+#include "../src/cookiescan.h"
+#include <cgixx/cgi.h>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+const char* const names[] = { "scalar", "sse2", "avx2" };
+
+// Classify every 64 byte block of header, zero padded at the end as the
+// scanner does, with every available variant.  Returns false on the
+// first mask that differs from the scalar classifier's.
+bool classifyall(const std::string& header)
+{
+	for (std::size_t b = 0; b < header.length(); b+= 64)
+	{
+		unsigned char block[64];
+		std::memset(block, 0, sizeof(block));
+		header.copy(reinterpret_cast<char*>(block), 64, b);
+		cgixx::blockmasks expected;
+		cgixx::classifywith(cgixx::codec_variant_scalar, block, expected);
+		for (int v = cgixx::codec_variant_sse2;
+			v <= cgixx::codec_variant_avx2; ++v)
+		{
+			cgixx::blockmasks m;
+			if (cgixx::classifywith(cgixx::codecvariant(v), block, m))
+				continue;
+			if (m.equals != expected.equals ||
+				m.semicolons != expected.semicolons ||
+				m.escapes != expected.escapes)
+			{
+				std::cout << names[v] << " masks differ at " << b << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Split a header byte by byte: a name runs to the next '=', its value to
+// the next ';', and white space after a ';' is skipped.
+std::vector<std::string> reference(const std::string& header)
+{
+	std::vector<std::string> tokens;
+	std::size_t pos = 0;
+	while (pos < header.length())
+	{
+		std::size_t eq = header.find('=', pos);
+		if (eq == std::string::npos)
+			break;
+		std::size_t semi = header.find(';', eq + 1);
+		if (semi == std::string::npos)
+			semi = header.length();
+		tokens.push_back(header.substr(pos, eq - pos) + "\n" +
+			header.substr(eq + 1, semi - eq - 1));
+		pos = semi + 1;
+		while (pos < header.length() && std::isspace(
+			static_cast<unsigned char>(header[pos])))
+			++pos;
+	}
+	return tokens;
+}
+
+// Split a header with cookiescanner, checking the escape flags.
+std::vector<std::string> scanned(const std::string& header)
+{
+	std::vector<std::string> tokens;
+	cgixx::cookiescanner scanner(header);
+	cgixx::cookiescanner::token t;
+	while (!scanner.next(t))
+	{
+		if (t.nameescaped != (t.name.find_first_of("%+") != t.name.npos) ||
+			t.valueescaped != (t.value.find_first_of("%+") != t.value.npos))
+			tokens.push_back("bad escape flag");
+		tokens.push_back(std::string(t.name) + "\n" + std::string(t.value));
+	}
+	return tokens;
+}
+
+// Look a cookie up with findcookie, or return "(none)".
+std::string cookie(const cgixx::cgi& cgi, std::string_view name)
+{
+	std::string_view value;
+	if (cgi.findcookie(name, value))
+		return "(none)";
+	return std::string(value);
+}
+
+void test()
+{
+	// Every byte value at every position of a block.
+	bool same = true;
+	for (int c = 0; c < 256; ++c)
+		for (std::size_t at = 0; at < 64; ++at)
+		{
+			std::string s(64, 'a');
+			s[at] = char(c);
+			same = classifyall(s) && same;
+		}
+	check(same, "every byte at every position");
+
+	// Random headers over several blocks, split as parsecookies always
+	// has.
+	const char alphabet[] = "==;;%+ \t";
+	std::srand(19);
+	bool masks = true, tokens = true;
+	for (int n = 0; n < 5000; ++n)
+	{
+		std::string s(65 + std::rand() % 300, 'x');
+		for (std::size_t i = 0; i < s.length(); ++i)
+			if (std::rand() % 4 == 0)
+				s[i] = alphabet[std::rand() % (sizeof(alphabet) - 1)];
+		masks = classifyall(s) && masks;
+		tokens = scanned(s) == reference(s) && tokens;
+	}
+	check(masks, "masks of headers longer than a block");
+	check(tokens, "tokens of headers longer than a block");
+
+	// A header with a cookie across the first block boundary.
+	std::string header("pad=" + std::string(50, 'p') + "; a=b=c; =empty; "
+		"%41b=1; x+y=2; n=v;;b=2; last=end;");
+	for (int deferred = 0; deferred < 2; ++deferred)
+	{
+		cgixx::cgi::environment env(queryenv(""));
+		env["HTTP_COOKIE"] = header;
+		cgixx::cgioptions opts;
+		opts.deferparse = deferred;
+		cgixx::cgi cgi(env, std::string(), opts);
+		std::string mode(deferred ? " deferred" : "");
+		check(cookie(cgi, "a") == "b=c", "'=' in a value" + mode);
+		check(cookie(cgi, "") == "empty", "empty name" + mode);
+		check(cookie(cgi, "Ab") == "1" && cookie(cgi, "%41b") == "(none)",
+			"escaped name" + mode);
+		check(cookie(cgi, "x y") == "2", "'+' in a name" + mode);
+		check(cookie(cgi, ";b") == "2" && cookie(cgi, "b") == "(none)",
+			"empty cookie" + mode);
+		check(cookie(cgi, "last") == "end", "trailing ';'" + mode);
+		check(cgi.countcookie("last") == 1 && cgi.countcookie("") == 1,
+			"count" + mode);
+	}
+}
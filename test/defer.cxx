@@ -0,0 +1,101 @@
+/*
+ * defer.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Check that deferred parsing leaves bad bodies alone until they are
+ * used, then throws the same cgiexception from every later use.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <string>
+
+// A POST request that also carries a session cookie.
+cgixx::cgi::environment cookieenv(const std::string& type,
+	const std::string& body)
+{
+	cgixx::cgi::environment env(postenv(type, body));
+	env["HTTP_COOKIE"] = "session=abc";
+	return env;
+}
+
+// Run f and return the message of the cgiexception it throws, or "".
+template <class F>
+std::string error(F f)
+{
+	try {
+		f();
+	} catch (const cgixx::cgiexception& e) {
+		return e.what();
+	}
+	return std::string();
+}
+
+void test()
+{
+	cgixx::cgioptions opts;
+	opts.deferparse = true;
+
+	std::string good("a=1&b=2&a=3");
+	cgixx::cgi ok(cookieenv("application/x-www-form-urlencoded", good), good,
+		opts);
+	check(ok.countvalues("a") == 2 && ok.exists("b"), "deferred parse");
+
+	std::string bad("--x\r\n");
+	// The boundary is missing, so the body cannot be parsed, but the
+	// constructor does not try.
+	cgixx::cgi c(cookieenv("multipart/form-data", bad), bad, opts);
+
+	std::string cookie;
+	check(!c.getcookie("session", cookie) && cookie == "abc",
+		"cookies are unaffected");
+
+	std::string first(error([&] { c.countvalues("a"); }));
+	check(!first.empty(), "first use throws");
+	check(error([&] { c.countvalues("a"); }) == first, "second use throws again");
+	check(error([&] { c.exists("a"); }) == first, "other methods throw too");
+	check(error([&] { c.countupload("f"); }) == first, "uploads throw too");
+	check(error([&] { c.parse(); }) == first, "parse throws the same");
+
+	// Limits are applied when the parse happens.
+	opts.limits.maxparams = 2;
+	cgixx::cgi limited(cookieenv("application/x-www-form-urlencoded", good),
+		good, opts);
+	std::string toomany(error([&] { limited.parse(); }));
+	check(!toomany.empty() && error([&] { limited.getvalues("a"); }) ==
+		toomany, "limit errors repeat");
+}
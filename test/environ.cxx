@@ -0,0 +1,170 @@
+/*
+ * environ.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Look up request headers by their HTTP names, at run time and through
+ * a constexpr httpheader, in an explicit environment.  Check which
+ * variables the environment snapshot captures, from an explicit
+ * environment and from the process environment.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <string>
+#include <string_view>
+#include <cstdlib>
+
+// Header names mapped at compile time.
+constexpr cgixx::httpheader contenttype("Content-Type");
+constexpr cgixx::httpheader contenttypex("Content-Typex");
+constexpr cgixx::httpheader acceptencoding("Accept-Encoding");
+static_assert(contenttype.envname() == "CONTENT_TYPE", "Content-Type");
+static_assert(cgixx::httpheader("content-length").envname() ==
+	"CONTENT_LENGTH", "content-length");
+static_assert(contenttypex.envname() == "HTTP_CONTENT_TYPEX",
+	"Content-Typex");
+static_assert(acceptencoding.envname() == "HTTP_ACCEPT_ENCODING",
+	"Accept-Encoding");
+static_assert(!cgixx::iscontentheader("Content-Typ") &&
+	!cgixx::iscontentheader("Content-Lengthy") &&
+	cgixx::iscontentheader("CONTENT-length"), "iscontentheader");
+
+// Look up a header by name at run time, or return "(none)".
+std::string header(const cgixx::cgi& cgi, std::string_view name)
+{
+	std::string_view value;
+	if (cgi.getrequestheader(name, value))
+		return "(none)";
+	return std::string(value);
+}
+
+// Variables the snapshot captures besides the headers enumeration.
+const char* const captured[] = {
+	"HTTP_ACCEPT_LANGUAGE", "HTTP_X_FORWARDED_FOR", "HTTP_", "HTTP_Z",
+	"DOCUMENT_ROOT", "HTTPS", "REDIRECT_STATUS", "REMOTE_PORT",
+	"REQUEST_SCHEME", "REQUEST_URI", "SCRIPT_FILENAME", "SERVER_ADDR",
+	"SERVER_ADMIN"
+};
+
+// Variables it leaves out.
+const char* const ignored[] = {
+	"PATH", "HOME", "HTTP", "HTTPSX", "DOCUMENT_ROOTS", "A_HTTP_X", "http_x"
+};
+
+const std::size_t capturedcount = sizeof(captured) / sizeof(captured[0]);
+const std::size_t ignoredcount = sizeof(ignored) / sizeof(ignored[0]);
+
+// Check that every captured variable is found with its value, whatever
+// order the snapshot was taken in, and that the others are not.
+bool snapshotagrees(const cgixx::cgi& cgi)
+{
+	bool ok = true;
+	std::string_view value;
+	for (std::size_t i = 0; i < capturedcount; ++i)
+		ok = ok && !cgi.getmetavar(captured[i], value) &&
+			value == std::string("v:") + captured[i];
+	for (std::size_t i = 0; i < ignoredcount; ++i)
+		ok = ok && cgi.getmetavar(ignored[i], value) && value.empty();
+	ok = ok && !cgi.getmetavar("SERVER_NAME", value) &&
+		value == "example.com" && !cgi.getheader(cgixx::header_server_name,
+		value) && value == "example.com" &&
+		!cgi.getheader(cgixx::header_query_string, value) && value == "q=1";
+	return ok;
+}
+
+void test()
+{
+	// A name longer than the buffer getrequestheader builds it in.
+	std::string longname(200, 'l');
+	longname.replace(0, 2, "X-");
+	std::string longenv("HTTP_X_" + std::string(198, 'L'));
+
+	cgixx::cgi::environment env(postenv("text/plain", "body"));
+	env["HTTP_CONTENT_TYPEX"] = "typex";
+	env["HTTP_ACCEPT_ENCODING"] = "gzip, br";
+	env[longenv] = "long";
+
+	cgixx::cgi cgi(env, "body");
+	check(header(cgi, "Content-Type") == "text/plain", "Content-Type");
+	check(header(cgi, "content-type") == "text/plain", "content-type");
+	check(header(cgi, "Content-Length") == "4", "Content-Length");
+	check(header(cgi, "Content-Typex") == "typex", "Content-Typex");
+	check(header(cgi, "Accept-Encoding") == "gzip, br", "Accept-Encoding");
+	check(header(cgi, "ACCEPT-ENCODING") == "gzip, br", "ACCEPT-ENCODING");
+	check(header(cgi, longname) == "long", "name longer than the buffer");
+	check(header(cgi, longname + "x") == "(none)", "long missing name");
+	check(header(cgi, "If-None-Match") == "(none)", "missing header");
+	check(header(cgi, "") == "(none)", "empty name");
+
+	std::string_view value;
+	check(!cgi.getrequestheader(contenttype, value) && value == "text/plain",
+		"constexpr Content-Type");
+	check(!cgi.getrequestheader(contenttypex, value) && value == "typex",
+		"constexpr Content-Typex");
+	check(!cgi.getrequestheader(acceptencoding, value) && value == "gzip, br",
+		"constexpr Accept-Encoding");
+	check(cgi.getrequestheader(cgixx::httpheader("Accept"), value) &&
+		value.empty(), "constexpr missing header");
+
+	check(!cgi.getmetavar("HTTP_ACCEPT_ENCODING", value) &&
+		value == "gzip, br", "getmetavar header");
+	check(!cgi.getmetavar("CONTENT_TYPE", value) && value == "text/plain",
+		"getmetavar CONTENT_TYPE");
+	check(cgi.getmetavar("ACCEPT_ENCODING", value) && value.empty(),
+		"getmetavar needs the HTTP_ prefix");
+
+	// The snapshot of an explicit environment, set up in reverse order so
+	// that it has to be sorted.
+	env = queryenv("q=1");
+	env["SERVER_NAME"] = "example.com";
+	for (std::size_t i = capturedcount; i-- > 0; )
+		env[captured[i]] = std::string("v:") + captured[i];
+	for (std::size_t i = 0; i < ignoredcount; ++i)
+		env[ignored[i]] = "ignored";
+	cgixx::cgi explicitenv(env, std::string());
+	check(snapshotagrees(explicitenv), "snapshot of an explicit environment");
+
+	// The snapshot of the process environment.
+	for (cgixx::cgi::environment::const_iterator it(env.begin());
+		it != env.end(); ++it)
+		if (it->first != "PATH" && it->first != "HOME")
+			setenv(it->first.c_str(), it->second.c_str(), 1);
+	unsetenv("CONTENT_TYPE");
+	unsetenv("CONTENT_LENGTH");
+	cgixx::cgi processenv;
+	check(snapshotagrees(processenv), "snapshot of the process environment");
+}
@@ -0,0 +1,240 @@
+/*
+ * fcgi.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Exercise fcgi_server against a minimal FastCGI client that stands in
+ * for the web server.  The server runs in a child process listening on
+ * a UNIX domain socket.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <cgixx/header.h>
+#include <cgixx/fcgi.h>
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const int requests = 2;
+
+// The application side: answer each request with its variables.
+void serve(int listenfd)
+{
+	cgixx::fcgi_server server(listenfd);
+	cgixx::cgioptions opts;
+	opts.limits.maxbody = 100;
+	server.setoptions(opts);
+	cgixx::fcgi_request req;
+	for (int i = 0; i < requests && !server.accept(req); ++i)
+	{
+		cgixx::cgi& cgi = req.getcgi();
+		cgixx::header header;
+		header.settype("text/plain");
+		req.out() << header.get();
+
+		cgixx::cgi::identifierlist idlist;
+		cgi.getvariablelist(idlist);
+		std::string val;
+		for (unsigned j = 0; j < idlist.size(); ++j)
+			while (!cgi.get(idlist[j], val))
+				req.out() << idlist[j] << "=" << val << "\n";
+		req.finish();
+	}
+}
+
+// The web server side.
+void record(std::string& out, int type, int id, const std::string& content)
+{
+	char hdr[8] = { 1, (char)type, (char)(id >> 8), (char)id,
+		(char)(content.length() >> 8), (char)content.length(), 0, 0 };
+	out.append(hdr, 8);
+	out+= content;
+}
+
+void pair(std::string& out, const std::string& name, const std::string& value)
+{
+	out+= (char)name.length();
+	out+= (char)value.length();
+	out+= name;
+	out+= value;
+}
+
+// Send a request.  Returns true if the application stopped reading it.
+bool sendrequest(int fd, int id, bool keepconn, const std::string& params,
+	const std::string& body)
+{
+	std::string msg;
+	char begin[8] = { 0, 1, (char)(keepconn ? 1 : 0), 0, 0, 0, 0, 0 };
+	record(msg, 1, id, std::string(begin, 8));
+	for (std::size_t i = 0; i < params.length(); i+= 65535)
+		record(msg, 4, id, params.substr(i, 65535));
+	record(msg, 4, id, "");
+	for (std::size_t i = 0; i < body.length(); i+= 65535)
+		record(msg, 5, id, body.substr(i, 65535));
+	record(msg, 5, id, "");
+	return write(fd, msg.data(), msg.length()) != (ssize_t)msg.length();
+}
+
+// Read the FCGI_STDOUT of a request up to its FCGI_END_REQUEST.
+std::string response(int fd)
+{
+	std::string out;
+	for (;;)
+	{
+		unsigned char hdr[8];
+		if (recv(fd, hdr, 8, MSG_WAITALL) != 8)
+			throw std::runtime_error("connection closed");
+		std::size_t len = (hdr[4] << 8) | hdr[5], pad = hdr[6];
+		std::string content(len + pad, '\0');
+		if (len + pad && recv(fd, &content[0], len + pad, MSG_WAITALL)
+			!= (ssize_t)(len + pad))
+			throw std::runtime_error("short record");
+		if (hdr[1] == 6)
+			out.append(content, 0, len);
+		else if (hdr[1] == 3)
+			return out;
+	}
+}
+
+std::string request(int fd, int id, bool keepconn, const std::string& params,
+	const std::string& body)
+{
+	if (sendrequest(fd, id, keepconn, params, body))
+		throw std::runtime_error("write failed");
+	return response(fd);
+}
+
+// Send a request that the application rejects, and return its answer.
+// The application may close the connection before it has all been sent.
+std::string rejected(const sockaddr_un& sa, const std::string& params,
+	const std::string& body)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(fd, (const sockaddr*)&sa, sizeof(sa)))
+		throw std::runtime_error("cannot connect");
+	sendrequest(fd, 1, true, params, body);
+	std::string out(response(fd));
+	// A closed connection reads as the end, or as reset if the rest of
+	// the request was never read.
+	timeval tv = { 5, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	char c;
+	ssize_t n = recv(fd, &c, 1, 0);
+	if (n > 0 || (n < 0 && errno != ECONNRESET))
+		throw std::runtime_error("connection left open");
+	close(fd);
+	return out;
+}
+
+// Check that out contains expect, labelled by its first line.
+void contains(const std::string& out, const std::string& expect)
+{
+	check(out.find(expect) != std::string::npos,
+		expect.substr(0, expect.find_first_of("\r\n")));
+}
+
+void test()
+{
+	char path[64];
+	std::sprintf(path, "/tmp/cgixx-fcgi-%d", (int)getpid());
+	sockaddr_un sa;
+	std::memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	std::strcpy(sa.sun_path, path);
+
+	int listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path);
+	if (listenfd < 0 || bind(listenfd, (sockaddr*)&sa, sizeof(sa)) ||
+		listen(listenfd, 1))
+		throw std::runtime_error("cannot listen");
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		serve(listenfd);
+		_exit(0);
+	}
+	close(listenfd);
+	signal(SIGPIPE, SIG_IGN);
+
+	std::string params, out;
+
+	// Bodies beyond maxbody and oversized parameters are answered
+	// without being buffered, and the connection is closed.
+	pair(params, "REQUEST_METHOD", "POST");
+	pair(params, "CONTENT_LENGTH", "150");
+	out = rejected(sa, params, std::string(150, 'x'));
+	contains(out, "Status: 413");
+	contains(out, "Request Entity Too Large\n");
+	out = rejected(sa, params, std::string(8 << 20, 'x'));
+	contains(out, "Status: 413");
+	for (int i = 0; i < 20000; ++i)
+		pair(params, "HTTP_X_" + std::to_string(i), std::string(60, 'v'));
+	out = rejected(sa, params, "");
+	contains(out, "Status: 431");
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(fd, (sockaddr*)&sa, sizeof(sa)))
+		throw std::runtime_error("cannot connect");
+
+	params.erase();
+	pair(params, "REQUEST_METHOD", "POST");
+	pair(params, "CONTENT_LENGTH", "15");
+	out = request(fd, 1, true, params, "a=1&b=two+words");
+	contains(out, "Content-type: text/plain\r\n");
+	contains(out, "a=1\n");
+	contains(out, "b=two words\n");
+
+	params.erase();
+	pair(params, "REQUEST_METHOD", "GET");
+	pair(params, "QUERY_STRING", "c=%41%42");
+	out = request(fd, 2, false, params, "");
+	contains(out, "c=AB\n");
+
+	close(fd);
+	waitpid(pid, 0, 0);
+	unlink(path);
+}
@@ -0,0 +1,106 @@
+/*
+ * form.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Bind request variables to a structure with a constexpr form: defaults,
+ * required fields, conversion errors and string members.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <cgixx/form.h>
+#include <string>
+#include <string_view>
+
+struct search {
+	std::string query;
+	std::string_view sort;
+	int page;
+	double weight;
+	bool exact;
+};
+
+constexpr auto searchform = cgixx::makeform(
+	cgixx::requiredfield("q", &search::query),
+	cgixx::field("sort", &search::sort, "date"),
+	cgixx::field("page", &search::page, 1),
+	cgixx::field("w", &search::weight, 0.5),
+	cgixx::field("exact", &search::exact));
+
+// Build a GET request, with lazy decoding if lazy.
+cgixx::cgi request(const std::string& query, bool lazy = false)
+{
+	cgixx::cgioptions opts;
+	opts.lazydecode = lazy;
+	return cgixx::cgi(queryenv(query), std::string(), opts);
+}
+
+void test()
+{
+	search s;
+	cgixx::formerror err;
+
+	cgixx::cgi full(request("q=red+shoes&sort=price%21&page=%2B3&w=2.5"
+		"&exact=on&q=second&other=%41"));
+	check(!searchform.bind(full, s, err), "bind");
+	check(s.query == "red shoes" && s.sort == "price!" && s.page == 3 &&
+		s.weight == 2.5 && s.exact, "values");
+	check(err.error == cgixx::get_ok && err.field.empty(), "no error");
+
+	check(!searchform.bind(request("q=x"), s, err), "defaults");
+	check(s.sort == "date" && s.page == 1 && s.weight == 0.5 && !s.exact,
+		"default values");
+
+	check(searchform.bind(request("page=2"), s, err) && err.field == "q" &&
+		err.error == cgixx::get_missing, "required field missing");
+	check(s.page == 2 && s.query.empty(), "other fields still bound");
+	check(searchform.bind(request("q=&page=2"), s, err) && err.field == "q" &&
+		err.error == cgixx::get_missing, "required field empty");
+
+	check(searchform.bind(request("q=x&page=two"), s, err) &&
+		err.field == "page" && err.error == cgixx::get_invalid && s.page == 1,
+		"bad conversion keeps the default");
+	check(searchform.bind(request("q=x&page=99999999999"), s, err) &&
+		err.error == cgixx::get_range, "out of range");
+	check(searchform.bind(request("q=x&exact=maybe&page=x"), s, err) &&
+		err.field == "exact", "first failure is reported");
+
+	cgixx::cgi lazy(request("q=a%20b&sort=%7Ename&" + std::string(200, 'z') +
+		"=%41", true));
+	check(!searchform.bind(lazy, s, err) && s.query == "a b" &&
+		s.sort == "~name", "lazy decoding");
+}
@@ -0,0 +1,209 @@
+/*
+ * header.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Write headers, with and without a body, to a pipe and to a file, and
+ * check that exactly what get() returns and then the body are written.
+ * Fill frozen headers with patches and check them against headers built
+ * with the same lines.
+ */
+
+#include "check.h"
+#include <cgixx/cookie.h>
+#include <cgixx/header.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+// What header::write sends through a pipe, for output that fits in it.
+std::string piped(const cgixx::header& h, const std::string& body)
+{
+	int fds[2];
+	if (pipe(fds))
+		throw std::runtime_error("cannot create pipe");
+	bool failed = h.write(fds[1], body.data(), body.length());
+	close(fds[1]);
+	std::string out;
+	char buf[4096];
+	ssize_t n;
+	while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+		out.append(buf, n);
+	close(fds[0]);
+	return failed ? "(failed)" : out;
+}
+
+// Set up a header as every frozen header test starts.
+void configure(cgixx::header& h, bool redirect)
+{
+	if (redirect)
+		h.redirect("/default");
+	else
+		h.settype("application/json");
+	h.setheader("Cache-Control", "no-store");
+	h.addcookie(cgixx::cookie("frozen", "1"));
+}
+
+// Check a frozen header filled with a patch against a header built with
+// the same lines: get, size, copy, append and write must all agree.
+bool agrees(const cgixx::frozenheader& frozen, const cgixx::headerpatch& patch,
+	const cgixx::header& built, std::FILE* f)
+{
+	std::string expected(nodate(built.get()));
+	std::string got(frozen.get(patch));
+	std::vector<char> buf(frozen.size(patch) + 1, '~');
+	std::size_t copied = frozen.copy(&buf[0], patch);
+	std::string appended("prefix");
+	frozen.append(appended, patch);
+	bool written = !frozen.write(fileno(f), patch, "body", 4);
+	std::string sent(drain(f));
+	return nodate(got) == expected && copied == frozen.size(patch) &&
+		copied == got.length() && buf[copied] == '~' &&
+		nodate(std::string(&buf[0], copied)) == expected &&
+		nodate(appended) == "prefix" + expected &&
+		written && nodate(sent) == expected + "body";
+}
+
+void frozen(std::FILE* f)
+{
+	cgixx::header base;
+	configure(base, false);
+	cgixx::frozenheader json(base.freeze());
+	cgixx::header redirectbase;
+	configure(redirectbase, true);
+	cgixx::frozenheader redirect(redirectbase.freeze());
+
+	cgixx::headerpatch empty;
+	check(agrees(json, empty, base, f), "empty patch");
+	check(agrees(redirect, empty, redirectbase, f),
+		"empty patch keeps the frozen Location");
+
+	cgixx::headerpatch location;
+	location.location = "/other?a=1";
+	cgixx::header relocated;
+	configure(relocated, true);
+	relocated.redirect("/other?a=1");
+	check(agrees(redirect, location, relocated, f), "location patch");
+
+	cgixx::headerpatch length;
+	length.length = 1234;
+	cgixx::header sized;
+	configure(sized, false);
+	sized.setlength(1234);
+	check(agrees(json, length, sized, f), "length patch");
+	check(!agrees(json, length, base, f), "length patch changes the header");
+	cgixx::headerpatch zero;
+	zero.haslength = true;
+	cgixx::header emptybody;
+	configure(emptybody, false);
+	emptybody.setlength(0, true);
+	check(agrees(json, zero, emptybody, f), "zero length patch");
+
+	cgixx::cookie session("session", "abc def");
+	session.setpath("/app");
+	cgixx::cookie lang("lang", "en");
+	std::string lines[] = { session.get(), lang.get() };
+	std::string_view views[] = { lines[0], lines[1] };
+	cgixx::headerpatch cookies;
+	cookies.cookies = views;
+	cookies.cookiecount = 2;
+	cgixx::header withcookies;
+	configure(withcookies, false);
+	withcookies.addcookie(session);
+	withcookies.addcookie(lang);
+	check(agrees(json, cookies, withcookies, f), "cookies patch");
+
+	cgixx::headerpatch all(cookies);
+	all.location = "/other?a=1";
+	all.length = 99;
+	cgixx::header everything;
+	configure(everything, true);
+	everything.redirect("/other?a=1");
+	everything.setlength(99);
+	everything.addcookie(session);
+	everything.addcookie(lang);
+	check(agrees(redirect, all, everything, f), "full patch");
+}
+
+void test()
+{
+	std::FILE* f = std::tmpfile();
+	if (!f)
+		throw std::runtime_error("tmpfile failed");
+
+	cgixx::header plain;
+	check(nodate(piped(plain, "")) == nodate(plain.get()), "default header");
+
+	cgixx::header h;
+	h.setstatus(404, "Not Found");
+	h.settype("text/plain");
+	h.setlength(5);
+	h.setexpire("Tue, 29-Feb-2000 00:00:00 GMT");
+	h.setheader("Cache-Control", "no-store");
+	cgixx::cookie c("id", "a b");
+	c.setpath("/");
+	h.addcookie(c);
+	h.addcookie(cgixx::cookie("lang", "en"));
+	check(nodate(piped(h, "")) == nodate(h.get()), "header alone");
+	check(nodate(piped(h, "hello")) == nodate(h.get()) + "hello",
+		"header and body");
+
+	cgixx::header moved;
+	moved.redirect("/elsewhere?a=1");
+	check(nodate(piped(moved, "")) == nodate(moved.get()), "redirect");
+
+	// More pieces than one writev takes, and a body larger than a pipe
+	// holds.
+	cgixx::header many;
+	for (int i = 0; i < 700; ++i)
+		many.setheader("X-Header-" + std::to_string(i), std::to_string(i));
+	std::string big(3 << 20, 'b');
+	for (std::size_t i = 0; i < big.length(); i+= 4093)
+		big[i] = char('a' + i % 26);
+	check(!many.write(fileno(f), big.data(), big.length()) &&
+		nodate(drain(f)) == nodate(many.get()) + big,
+		"many lines and a large body");
+	check(!many.write(fileno(f)) && nodate(drain(f)) == nodate(many.get()),
+		"many lines");
+
+	check(h.write(-1), "bad descriptor fails");
+
+	frozen(f);
+	std::fclose(f);
+}
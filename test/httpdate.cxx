@@ -0,0 +1,125 @@
+/*
+ * httpdate.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Format known dates and a spread of others checked against gmtime, and
+ * check expire offsets and the per-second caching of the current date.
+ */
+
+#include "check.h"
+#include "../src/httpdate.h"
+#include <string>
+#include <ctime>
+
+std::string format(std::time_t t)
+{
+	char buf[cgixx::httpdatelength];
+	return std::string(buf, cgixx::formathttpdate(t, buf));
+}
+
+// The date as gmtime and strftime give it.
+std::string reference(std::time_t t)
+{
+	char buf[64];
+	std::size_t n = std::strftime(buf, sizeof(buf),
+		"%a, %d-%b-%Y %H:%M:%S GMT", std::gmtime(&t));
+	return std::string(buf, n);
+}
+
+// Get an expire offset and the time it was taken at, retrying if the
+// second changed meanwhile.
+bool offset(const char* expire, std::time_t& when, std::time_t& now)
+{
+	for (;;)
+	{
+		now = std::time(0);
+		bool failed = cgixx::expireoffset(expire, when);
+		if (std::time(0) == now)
+			return failed;
+	}
+}
+
+void test()
+{
+	check(format(0) == "Thu, 01-Jan-1970 00:00:00 GMT", "epoch");
+	check(format(951782400) == "Tue, 29-Feb-2000 00:00:00 GMT",
+		"leap day of a leap century");
+	check(format(1709210096) == "Thu, 29-Feb-2024 12:34:56 GMT", "leap day");
+	check(format(4107542400LL) == "Mon, 01-Mar-2100 00:00:00 GMT",
+		"day after February of a common century");
+	check(format(253402300799LL) == "Fri, 31-Dec-9999 23:59:59 GMT",
+		"last date");
+	check(format(253402300800LL) == format(253402300799LL) &&
+		format(-1) == format(0), "dates out of range are clamped");
+	check(format(253402300799LL).length() == cgixx::httpdatelength,
+		"httpdatelength");
+
+	bool same = true;
+	if (sizeof(std::time_t) > 4)
+		for (long long t = 0; t < 253402300799LL; t+= 86400LL * 97 + 3607)
+			same = same && format(std::time_t(t)) == reference(std::time_t(t));
+	else
+		for (long long t = 0; t < 0x7fffffffLL; t+= 86400LL * 7 + 3607)
+			same = same && format(std::time_t(t)) == reference(std::time_t(t));
+	check(same, "dates agree with gmtime");
+
+	std::time_t when, now;
+	check(!offset("1D", when, now) && when == now + 86400, "1D");
+	check(!offset("+1D", when, now) && when == now + 86400, "+1D");
+	check(!offset("-1D", when, now) && when == now - 86400 && when < now,
+		"-1D");
+	check(!offset("90M", when, now) && when == now + 5400, "90M");
+	check(!offset("2w", when, now) && when == now + 14 * 86400, "2w");
+	check(!offset("99999999999Y", when, now) && when == 253402300799LL,
+		"offsets are clamped");
+	check(offset("+", when, now) && offset("-D", when, now) &&
+		offset("1", when, now) && offset("1X", when, now) &&
+		offset("Tue, 29-Feb-2000 00:00:00 GMT", when, now),
+		"not offsets");
+
+	// Two calls in the same second give the same text from the cache.
+	for (;;)
+	{
+		std::time_t t = std::time(0);
+		std::string first(cgixx::httpdatenow());
+		std::string second(cgixx::httpdatenow());
+		if (std::time(0) != t)
+			continue;
+		check(first == second && first == format(t), "httpdatenow");
+		break;
+	}
+}
@@ -0,0 +1,99 @@
+/*
+ * json.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Parse application/json bodies and look values up by JSON pointer,
+ * with strings long enough to cross the 64 byte blocks of the scanner.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <string>
+
+bool malformed(const std::string& body)
+{
+	try {
+		cgixx::cgi cgi(postenv("application/json; charset=utf-8", body), body);
+	} catch (const cgixx::cgiexception&) {
+		return true;
+	}
+	return false;
+}
+
+void test()
+{
+	std::string padding(70, 'x');
+	std::string body("{\"user\": {\"name\": \"" + padding + "\\\"q\\\\\", "
+		"\"id\": 42, \"score\": -1.5e2, \"admin\": false},\n"
+		"\"items\": [ {\"a/b\": \"\\u00e9\\ud83d\\ude00\"}, null, true ],\n"
+		"\"empty\": {}, \"" + padding + "\": []}");
+	cgixx::cgi cgi(postenv("application/json; charset=utf-8", body), body);
+
+	long long id;
+	double score;
+	bool admin;
+	check(cgi.getjson("/user/name").getstring() == padding + "\"q\\",
+		"escaped string across blocks");
+	check(!cgi.getjson("/user/id").getnumber(id) && id == 42, "integer");
+	check(!cgi.getjson("/user/score").getnumber(score) && score == -150,
+		"double");
+	check(cgi.getjson("/user/score").getnumber(id), "double is not an integer");
+	check(!cgi.getjson("/user/admin").getbool(admin) && !admin, "boolean");
+	check(cgi.getjson("/items/0/a~1b").getstring() == "\xc3\xa9\xf0\x9f\x98\x80",
+		"unicode escapes");
+	check(cgi.getjson("/items/1").gettype() == cgixx::json_null, "null");
+	check(cgi.getjson("/items").size() == 3 && !cgi.getjson("/items/3").exists(),
+		"array size");
+	check(cgi.getjson("/empty").gettype() == cgixx::json_object &&
+		!cgi.getjson("/empty").first().exists(), "empty object");
+	check(cgi.getjson("/" + padding).gettype() == cgixx::json_array, "long key");
+
+	std::string keys;
+	for (cgixx::jsonvalue v = cgi.getjson().first(); v.exists(); v = v.next())
+		keys+= std::string(v.getkey().substr(0, 5)) + ",";
+	check(keys == "user,items,empty,xxxxx,", "member iteration");
+
+	check(malformed("{\"a\": 1,}"), "trailing comma");
+	check(malformed("[1 2]"), "missing comma");
+	check(malformed("\"abc"), "unterminated string");
+	check(malformed("[01]"), "leading zero");
+	check(malformed("{\"a\": tru}"), "bad literal");
+	check(malformed("\"\\x\""), "bad escape");
+	check(malformed("[\"\t\"]"), "control character in string");
+	check(malformed("{} {}"), "two values");
+}
@@ -0,0 +1,174 @@
+/*
+ * move.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Move headers, cookies and cgi instances, with their pimpls in inline
+ * storage or allocated from a resource, and check that the moved object
+ * produces what the original did.
+ */
+
+#include "check.h"
+#include "../src/pmralloc.h"
+#include <cgixx/cgi.h>
+#include <cgixx/cookie.h>
+#include <cgixx/header.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// What header::write sends, without a body.
+std::string written(const cgixx::header& h)
+{
+	int fds[2];
+	if (pipe(fds))
+		throw std::runtime_error("cannot create pipe");
+	bool failed = h.write(fds[1]);
+	close(fds[1]);
+	std::string out;
+	char buf[4096];
+	ssize_t n;
+	while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+		out.append(buf, n);
+	close(fds[0]);
+	return failed ? std::string() : out;
+}
+
+// Give a header something in every member.
+void configure(cgixx::header& h, const std::string& tag)
+{
+	h.setstatus(404, "Not Found");
+	h.settype("text/plain; charset=" + tag);
+	h.setlength(1234);
+	h.setheader("X-Tag", tag + std::string(100, 'x'));
+	h.setheader("Cache-Control", "no-store");
+	h.addcookie(cgixx::cookie("id", tag));
+}
+
+// A pimpl that fits in 64 bytes of storage, and one that does not.
+struct smallimpl {
+	std::pmr::memory_resource* resource;
+	int value;
+	smallimpl(std::pmr::memory_resource* r, int v) : resource(r), value(v) {}
+};
+
+struct bigimpl {
+	std::pmr::memory_resource* resource;
+	char data[256];
+	bigimpl(std::pmr::memory_resource* r, int v) : resource(r), data()
+	{ data[255] = char(v); }
+};
+
+void test()
+{
+	// The two ways makeimpl places a pimpl.
+	countingresource counter;
+	alignas(std::max_align_t) unsigned char storage[64];
+	smallimpl* small = cgixx::makeimpl<smallimpl>(storage, &counter,
+		&counter, 5);
+	check(cgixx::isinline(storage, small) && small->value == 5 &&
+		counter.allocations == 0, "small pimpl is inline");
+	cgixx::destroyimpl(storage, small);
+	bigimpl* big = cgixx::makeimpl<bigimpl>(storage, &counter, &counter, 7);
+	check(!cgixx::isinline(storage, big) && big->data[255] == 7 &&
+		counter.live == 1, "big pimpl is allocated");
+	cgixx::destroyimpl(storage, big);
+	check(counter.live == 0, "big pimpl is freed");
+
+	// Move construction, with the default and a counting resource.
+	cgixx::header original;
+	configure(original, "a");
+	std::string expected(nodate(original.get()));
+	check(nodate(written(original)) == expected, "write matches get");
+	cgixx::header moved(std::move(original));
+	check(nodate(moved.get()) == expected, "moved header get");
+	check(nodate(written(moved)) == expected, "moved header write");
+
+	countingresource headers;
+	cgixx::header counted(&headers);
+	configure(counted, "b");
+	std::string countedexpected(nodate(counted.get()));
+	unsigned long before = headers.allocations;
+	cgixx::header countedmoved(std::move(counted));
+	check(headers.allocations == before, "moving a header allocates nothing");
+	check(nodate(countedmoved.get()) == countedexpected,
+		"moved header with a resource");
+
+	// Move assignment over a header in use.
+	cgixx::header target(&headers);
+	configure(target, "c");
+	target.redirect("/elsewhere");
+	target = std::move(countedmoved);
+	check(nodate(target.get()) == countedexpected, "move assigned header");
+	check(nodate(written(target)) == countedexpected,
+		"move assigned header write");
+	target = std::move(moved);
+	check(nodate(target.get()) == expected,
+		"move assigned across resources");
+
+	// Cookies moved as a vector grows.
+	std::vector<cgixx::cookie> cookies;
+	std::vector<std::string> cookieexpected;
+	for (int i = 0; i < 40; ++i)
+	{
+		cgixx::cookie c("name" + std::to_string(i),
+			std::string(i * 3, 'v'), &headers);
+		c.setpath("/p" + std::to_string(i));
+		if (i % 2)
+			c.setdomain("example.com");
+		cookieexpected.push_back(c.get());
+		cookies.push_back(std::move(c));
+	}
+	bool same = true;
+	for (std::size_t i = 0; i < cookies.size(); ++i)
+		same = same && cookies[i].get() == cookieexpected[i];
+	check(same, "cookies moved by a growing vector");
+	cookies.front() = std::move(cookies.back());
+	check(cookies.front().get() == cookieexpected.back(),
+		"move assigned cookie");
+
+	// A cgi moved and move assigned keeps its request.
+	cgixx::cgi request(queryenv("a=1&b=two+words&a=3"), std::string());
+	cgixx::cgi taken(std::move(request));
+	std::string value;
+	check(taken.countvalues("a") == 2 && !taken.get("b", value) &&
+		value == "two words", "moved cgi");
+	cgixx::cgi other(queryenv("x=9"), std::string());
+	other = std::move(taken);
+	std::string_view a;
+	check(!other.exists("x") && !other.getvalue("a", 1, a) && a == "3",
+		"move assigned cgi");
+}
@@ -0,0 +1,135 @@
+/*
+ * multipart.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * Parse a multipart/form-data body, once supplied directly and once
+ * from STDIN in blocks, with a small spill threshold so the larger file
+ * goes to a temporary file.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+void verify(cgixx::cgi& cgi, const std::string& big)
+{
+	std::string val;
+	check(!cgi.get("title", val) && val == "A \"quoted\"\r\nvalue", "text field");
+	check(!cgi.get("tag", val) && val == "one+two%21", "field is not url-decoded");
+	check(!cgi.get("tag", val) && val == "three", "repeated field");
+
+	check(cgi.countupload("doc") == 2, "upload count");
+	const cgixx::upload* up = cgi.getupload("doc");
+	check(up && up->getfilename() == "a.txt" && up->gettype() == "text/plain"
+		&& up->inmemory() && std::string(up->data(), up->size()) == "small",
+		"file in memory");
+	up = cgi.getupload("doc", 1);
+	check(up && up->getfilename() == "b\"c.bin" && !up->inmemory()
+		&& up->getfd() >= 0 && up->size() == big.length()
+		&& std::string(up->data(), up->size()) == big,
+		"file spilled to disk");
+	check(!cgi.getupload("doc", 2), "no third file");
+
+	cgixx::cgi::identifierlist idlist;
+	cgi.getuploadlist(idlist);
+	check(idlist.size() == 1 && idlist[0] == "doc", "upload list");
+}
+
+void part(std::string& body, const std::string& disposition,
+	const std::string& type, const std::string& content)
+{
+	body+= "--XyZ\r\nContent-Disposition: form-data; " + disposition + "\r\n";
+	if (!type.empty())
+		body+= "Content-Type: " + type + "\r\n";
+	body+= "\r\n" + content + "\r\n";
+}
+
+void test()
+{
+	// Put near-delimiters in the large file to exercise the search.
+	std::string big;
+	for (int i = 0; big.length() < 5000; ++i)
+		big+= (i % 7) ? "data\r\n--XyY" : "\r\n\r\n--Xy";
+
+	std::string body("preamble\r\n");
+	part(body, "name=\"title\"", "", "A \"quoted\"\r\nvalue");
+	part(body, "name=\"tag\"", "", "one+two%21");
+	part(body, "name=\"doc\"; filename=\"a.txt\"", "text/plain", "small");
+	part(body, "name=\"doc\"; filename=\"b\\\"c.bin\"",
+		"application/octet-stream", big);
+	part(body, "name=tag", "", "three");
+	body+= "--XyZ--\r\nepilogue";
+
+	cgixx::cgioptions opts;
+	opts.spillthreshold = 1000;
+
+	const char* const type = "multipart/form-data; boundary=\"XyZ\"";
+	{
+		cgixx::cgi cgi(postenv(type, body), body, opts);
+		verify(cgi, big);
+	}
+
+	std::string truncated(body.substr(0, body.find("--XyZ--")));
+	bool threw = false;
+	try {
+		cgixx::cgi cgi(postenv(type, truncated), truncated, opts);
+	} catch (const cgixx::cgiexception&) {
+		threw = true;
+	}
+	check(threw, "truncated body throws");
+
+	// The same body read from STDIN in blocks.
+	std::FILE* f = std::tmpfile();
+	if (!f || std::fwrite(body.data(), 1, body.length(), f) != body.length())
+		throw std::runtime_error("cannot write temporary file");
+	std::rewind(f);
+	if (::dup2(fileno(f), 0) < 0)
+		throw std::runtime_error("cannot redirect STDIN");
+	std::fclose(f);
+	setenv("REQUEST_METHOD", "POST", 1);
+	setenv("CONTENT_TYPE", "multipart/form-data; boundary=XyZ", 1);
+	setenv("CONTENT_LENGTH", std::to_string(body.length()).c_str(), 1);
+	{
+		cgixx::cgi cgi(opts);
+		verify(cgi, big);
+	}
+}
@@ -0,0 +1,148 @@
+/*
+ * paramlist.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Look up variables and cookies among enough names that they are found
+ * through the hash index instead of by binary search, and check that
+ * every way of reading them agrees.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map< std::string, std::vector<std::string> > expectation;
+
+// Build a query, or a cookie header if cookies, with names many of which
+// repeat, and record the values expected for each name.
+std::string build(std::size_t names, bool cookies, expectation& expected)
+{
+	std::string s;
+	for (std::size_t round = 0; round < 3; ++round)
+		for (std::size_t i = 0; i < names; ++i)
+		{
+			if (round && i % (round + 2))
+				continue;
+			std::string name("name" + std::to_string(i));
+			std::string value(std::to_string(i) + "." +
+				std::to_string(round));
+			expected[name].push_back(value);
+			if (!s.empty())
+				s+= cookies ? "; " : "&";
+			s+= name + "=" + value;
+		}
+	return s;
+}
+
+// Check each name of expected, and names that are not there, through
+// countvalues, getvalues, getvalue and get.
+bool agrees(cgixx::cgi& cgi, const expectation& expected)
+{
+	bool ok = true;
+	for (expectation::const_iterator it(expected.begin());
+		it != expected.end(); ++it)
+	{
+		const std::vector<std::string>& values = it->second;
+		cgixx::cgi::valuerange range(cgi.getvalues(it->first));
+		ok = ok && cgi.exists(it->first) &&
+			cgi.countvalues(it->first) == values.size() &&
+			range.size() == values.size();
+		for (std::size_t i = 0; ok && i < values.size(); ++i)
+		{
+			std::string_view view;
+			std::string value;
+			ok = range[i] == values[i] &&
+				!cgi.getvalue(it->first, i, view) && view == values[i] &&
+				!cgi.get(it->first, value) && value == values[i];
+		}
+		std::string_view view;
+		ok = ok && cgi.getvalue(it->first, values.size(), view);
+	}
+
+	const char* const misses[] = {
+		"", "name", "name50", "Name1", "name1 ", "name01", "name100"
+	};
+	for (std::size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); ++i)
+	{
+		std::string value;
+		ok = ok && !cgi.exists(misses[i]) && !cgi.countvalues(misses[i]) &&
+			cgi.getvalues(misses[i]).empty() && cgi.get(misses[i], value);
+	}
+	return ok;
+}
+
+// Check each cookie of expected, and cookies that are not there.
+bool cookiesagree(cgixx::cgi& cgi, const expectation& expected)
+{
+	bool ok = true;
+	for (expectation::const_iterator it(expected.begin());
+		it != expected.end(); ++it)
+	{
+		std::string_view view;
+		std::string value;
+		ok = ok && cgi.countcookie(it->first) == it->second.size() &&
+			!cgi.findcookie(it->first, view) && view == it->second[0] &&
+			!cgi.getcookie(it->first, value) && value == it->second[0];
+	}
+	std::string_view view;
+	ok = ok && !cgi.countcookie("name50") && cgi.findcookie("name50", view) &&
+		cgi.findcookie("", view);
+	return ok;
+}
+
+void test()
+{
+	// Few names use binary search, many the hash index.
+	const std::size_t counts[] = { 5, 8, 9, 50 };
+	for (std::size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		std::string label(std::to_string(counts[c]) + " names");
+		expectation vars, cookies;
+		cgixx::cgi::environment env(queryenv(build(counts[c], false, vars)));
+		env["HTTP_COOKIE"] = build(counts[c], true, cookies);
+		cgixx::cgi cgi(env, std::string());
+		check(agrees(cgi, vars), "variables of " + label);
+		check(cookiesagree(cgi, cookies), "cookies of " + label);
+
+		cgixx::cgioptions opts;
+		opts.lazydecode = true;
+		cgixx::cgi lazy(env, std::string(), opts);
+		check(agrees(lazy, vars), "lazy variables of " + label);
+	}
+}
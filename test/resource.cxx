@@ -0,0 +1,123 @@
+/*
+ * resource.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Parse requests and build headers and cookies with a memory resource,
+ * and check that their memory comes from it: the default resource is
+ * replaced by one that counts stray allocations, and the supplied
+ * resources either count or have no upstream to fall back on.
+ */
+
+#include "check.h"
+#include <cgixx/cgi.h>
+#include <cgixx/cookie.h>
+#include <cgixx/header.h>
+#include <string>
+
+// A multipart/form-data body with a field and a small file.
+std::string multipartbody()
+{
+	return "--XyZ\r\n"
+		"Content-Disposition: form-data; name=\"tag\"\r\n\r\n"
+		"one\r\n"
+		"--XyZ\r\n"
+		"Content-Disposition: form-data; name=\"f\"; filename=\"a.txt\"\r\n"
+		"Content-Type: text/plain\r\n\r\n"
+		"file contents\r\n"
+		"--XyZ--\r\n";
+}
+
+void test()
+{
+	countingresource strays;
+	std::pmr::memory_resource* previous =
+		std::pmr::set_default_resource(&strays);
+
+	// A GET request with a counting resource.
+	countingresource counter;
+	cgixx::cgioptions opts;
+	opts.resource = &counter;
+	{
+		cgixx::cgi cgi(queryenv("a=1&b=%41%42&a=2"), std::string(), opts);
+		std::string_view b;
+		check(cgi.countvalues("a") == 2 && !cgi.getvalue("b", 0, b) &&
+			b == "AB", "GET parse");
+		check(counter.allocations > 0, "GET parse allocates from resource");
+	}
+	check(counter.live == 0, "cgi frees all it allocated");
+
+	// Header and cookie with a counting resource.
+	counter.allocations = 0;
+	{
+		cgixx::header h(&counter);
+		h.settype("text/plain");
+		h.setheader("X-Long", std::string(200, 'x'));
+		cgixx::cookie c("session", std::string(100, 'v'), &counter);
+		c.setpath("/app");
+		h.addcookie(c);
+		check(h.get().find("session=") != std::string::npos &&
+			counter.allocations > 0, "header and cookie allocate from resource");
+	}
+	check(counter.live == 0, "header and cookie free all they allocated");
+
+	// The same with an arena that cannot grow, so any allocation the
+	// arena does not serve throws.
+	alignas(std::max_align_t) static unsigned char block[1 << 16];
+	std::pmr::monotonic_buffer_resource arena(block, sizeof(block),
+		std::pmr::null_memory_resource());
+	opts.resource = &arena;
+	bool threw = false;
+	try {
+		cgixx::cgi cgi(queryenv("a=1&b=%41%42"), std::string(), opts);
+		cgixx::header h(&arena);
+		h.setheader("X-Long", std::string(200, 'x'));
+		cgixx::cookie c("session", std::string(100, 'v'), &arena);
+		h.addcookie(c);
+		std::string body(multipartbody());
+		cgixx::cgi post(postenv("multipart/form-data; boundary=XyZ", body),
+			body, opts);
+		std::string_view tag;
+		check(!post.getvalue("tag", 0, tag) && tag == "one",
+			"multipart parse in arena");
+	} catch (const std::bad_alloc&) {
+		threw = true;
+	}
+	check(!threw, "arena without upstream suffices");
+
+	std::pmr::set_default_resource(previous);
+	check(strays.allocations == 0, "nothing from the default resource");
+}
@@ -0,0 +1,155 @@
+/*
+ * response.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Send buffered, streamed and frozen-header responses to a temporary
+ * file and check what was written, including bodies large enough to be
+ * kept in mapped memory.
+ */
+
+#include "check.h"
+#include <cgixx/header.h>
+#include <cgixx/response.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <unistd.h>
+
+void test()
+{
+	std::FILE* f = std::tmpfile();
+	if (!f)
+		throw std::runtime_error("tmpfile failed");
+	int fd = fileno(f);
+
+	{
+		cgixx::response res(fd);
+		res.gethead().settype("text/plain");
+		res.out() << "Hello, " << 42;
+		res.write(std::string_view("!"));
+		check(res.length() == 10, "buffered length");
+		check(!res.finish(), "finish");
+		check(!res.finish(), "finish twice");
+	}
+	check(nodate(drain(f)) == "Content-type: text/plain\r\n"
+		"Content-length: 10\r\n\r\nHello, 42!", "automatic content length");
+
+	{
+		cgixx::response res(fd);
+		res.gethead().setstatus(204, "No Content");
+		res.finish();
+	}
+	check(nodate(drain(f)) == "Status: 204 No Content\r\n"
+		"Content-type: text/html\r\nContent-length: 0\r\n\r\n",
+		"empty body sends a length of 0");
+
+	std::string big;
+	for (int i = 0; big.length() < 3000000; ++i)
+		big+= std::to_string(i) + ',';
+	{
+		cgixx::response res(fd);
+		for (std::size_t i = 0; i < big.length(); i+= 1000)
+			res.write(big.data() + i, std::min<std::size_t>(1000,
+				big.length() - i));
+		res.finish();
+	}
+	std::string text = drain(f);
+	check(text.find("Content-length: " + std::to_string(big.length()) +
+		"\r\n") != std::string::npos && text.substr(text.find("\r\n\r\n") + 4)
+		== big, "large body");
+
+	{
+		cgixx::response res(fd);
+		res.out() << "start,";
+		check(!res.stream(), "stream");
+		res.out() << big;
+		res.write(big);
+		check(res.length() < 65536, "streaming sends blocks");
+	}
+	text = drain(f);
+	check(text.find("Content-length") == std::string::npos &&
+		text.substr(text.find("\r\n\r\n") + 4) == "start," + big + big,
+		"streamed body sent on destruction");
+
+	{
+		cgixx::response res(fd);
+		res.out() << "discarded";
+	}
+	check(drain(f).empty(), "unfinished response is discarded");
+
+	cgixx::header h;
+	h.settype("application/json");
+	h.setheader("Cache-Control", "no-store");
+	cgixx::frozenheader frozen(h.freeze());
+	std::string_view cookies[1] = { "Set-Cookie: a=b" };
+	cgixx::headerpatch patch;
+	patch.cookies = cookies;
+	patch.cookiecount = 1;
+	{
+		cgixx::response res(fd);
+		res.usefrozen(frozen, patch);
+		res.out() << "{}";
+		res.finish();
+	}
+	check(nodate(drain(f)) == "Content-type: application/json\r\n"
+		"Content-length: 2\r\nCache-Control: no-store\r\n"
+		"Set-Cookie: a=b\r\n\r\n{}", "frozen header");
+
+	// A length preset in the patch is replaced, even by 0.
+	patch.length = 99;
+	patch.cookiecount = 0;
+	{
+		cgixx::response res(fd);
+		res.usefrozen(frozen, patch);
+		res.finish();
+	}
+	check(nodate(drain(f)) == "Content-type: application/json\r\n"
+		"Content-length: 0\r\nCache-Control: no-store\r\n\r\n",
+		"frozen header with an empty body");
+
+	std::ostringstream sink;
+	{
+		cgixx::response res(sink);
+		res.out() << "abc";
+		res.finish();
+	}
+	check(nodate(sink.str()) == "Content-type: text/html\r\n"
+		"Content-length: 3\r\n\r\nabc", "stream sink");
+
+	std::fclose(f);
+}
@@ -0,0 +1,255 @@
+/*
+ * urlcodec.cxx
+ *
+ */
+
+/*
+ * Copyright (C) 2002-2004 Isaac W. Foraker (isaac at noscience dot net)
+ * All Rights Reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Author nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Run each compiled percent-decoder directly on well formed, truncated
+ * and invalid escapes, and check that it decodes exactly as cgixx always
+ * has.  Run each encoder on every byte value at every position around
+ * its blocks, and check that it encodes as the scalar one does.
+ */
+
+#include "check.h"
+#include "../src/urlcodec.h"
+#include <string>
+#include <cstdlib>
+
+// The digit values used by cgixx 1.07, including for non-hex digits.
+unsigned char hex2dec(char c)
+{
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return c - '0';
+}
+
+// The decoder of cgixx 1.07.
+std::string reference(const std::string& cgistr)
+{
+	std::string textstr;
+	std::string::const_iterator it(cgistr.begin()), end(cgistr.end());
+
+	for (; it != end; ++it)
+	{
+		if (*it == '%')
+		{
+			++it;
+			if (it == end)
+				break;
+			unsigned char temp = hex2dec(*it) * 16;
+			++it;
+			if (it == end)
+				break;
+			temp+= hex2dec(*it);
+			textstr+= temp;
+		}
+		else if (*it == '+')
+			textstr+= ' ';
+		else
+			textstr+= *it;
+	}
+
+	return textstr;
+}
+
+const char* const names[] = { "scalar", "sse2", "avx2" };
+
+// Decode input with every available variant and compare each with the
+// 1.07 decoder.  Returns false on the first mismatch.
+bool decodeall(const std::string& input)
+{
+	std::string expected(reference(input));
+	for (int v = cgixx::codec_variant_scalar;
+		v <= cgixx::codec_variant_avx2; ++v)
+	{
+		std::string buf(input);
+		std::size_t len;
+		if (cgixx::cgi2textwith(cgixx::codecvariant(v), &buf[0],
+			buf.length(), len))
+			continue;
+		buf.resize(len);
+		if (buf != expected)
+		{
+			std::cout << names[v] << " decoded \"" << input << "\" as \"" <<
+				buf << "\"" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// The encoding of text2cgi, or of appendsafestring if safe.
+std::string referenceencode(const std::string& text, bool safe)
+{
+	std::string out;
+	for (std::size_t i = 0; i < text.length(); ++i)
+	{
+		unsigned char c = text[i];
+		if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+			(c >= 'a' && c <= 'z') || (safe && c == '_'))
+			out+= c;
+		else if (safe && c == ' ')
+			out+= '+';
+		else
+		{
+			out+= '%';
+			out+= "0123456789ABCDEF"[c >> 4];
+			out+= "0123456789ABCDEF"[c & 15];
+		}
+	}
+	return out;
+}
+
+// Encode input with every available variant, both ways, appending to a
+// prefix, and compare each with the scalar encoder and the reference.
+// Returns false on the first mismatch.
+bool encodeall(const std::string& input)
+{
+	for (int safe = 0; safe < 2; ++safe)
+	{
+		std::string expected("prefix" + referenceencode(input, safe));
+		for (int v = cgixx::codec_variant_scalar;
+			v <= cgixx::codec_variant_avx2; ++v)
+		{
+			std::string out("prefix");
+			if (cgixx::encodewith(cgixx::codecvariant(v), input, out, safe))
+				continue;
+			if (out != expected)
+			{
+				std::cout << names[v] << (safe ? " safe" : "") <<
+					" encoding of " << input.length() << " bytes differs" <<
+					std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void test()
+{
+	std::size_t len;
+	char c = 0;
+	check(!cgixx::cgi2textwith(cgixx::codec_variant_scalar, &c, 0, len),
+		"scalar decoder runs");
+
+	const char* const cases[] = {
+		"", "%", "%4", "%41", "%zz", "%4z", "%z4", "+", "++", "a+b%20c",
+		"%%41", "%+41", "100%", "abc%4", "%E9%e9%Ff", "%00x", "%G0%:;",
+	};
+	bool same = true;
+	for (std::size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+		same = decodeall(cases[i]) && same;
+	check(same, "short escapes decode as in 1.07");
+
+	// Escapes at every position around the 16 and 32 byte blocks, and
+	// truncated at the end of the input.
+	std::string run(70, 'x');
+	const char* const escapes[] = { "%41", "%zz", "+", "%", "%4" };
+	same = true;
+	for (std::size_t e = 0; e < sizeof(escapes) / sizeof(escapes[0]); ++e)
+	{
+		for (std::size_t at = 0; at <= run.length(); ++at)
+		{
+			std::string s(run);
+			s.insert(at, escapes[e]);
+			same = decodeall(s) && same;
+			same = decodeall(s.substr(0, at + 1)) && same;
+		}
+	}
+	check(same, "escapes around block boundaries");
+
+	// Random mixes of clean runs, escapes and malformed escapes.
+	const char alphabet[] = "%%%++aZ09fFgG:;&= \x80\xff";
+	std::srand(4);
+	same = true;
+	for (int n = 0; n < 20000; ++n)
+	{
+		std::string s;
+		std::size_t len = std::rand() % 100;
+		for (std::size_t i = 0; i < len; ++i)
+			s+= std::rand() % 3 ? 'a' + std::rand() % 26 :
+				alphabet[std::rand() % (sizeof(alphabet) - 1)];
+		same = decodeall(s) && same;
+	}
+	check(same, "random inputs");
+
+	std::string out;
+	check(!cgixx::encodewith(cgixx::codec_variant_scalar, "a b", out, true) &&
+		out == "a+b", "scalar encoder runs");
+
+	// Every byte value, alone in runs of clean bytes at every position
+	// around the 16 and 32 byte blocks, and repeated to lengths on either
+	// side of them.
+	same = true;
+	const std::size_t lengths[] = {
+		0, 1, 15, 16, 17, 31, 32, 33, 47, 48, 49, 63, 64, 65, 95, 96, 97
+	};
+	for (int c = 0; c < 256; ++c)
+	{
+		for (std::size_t at = 0; at <= 70; ++at)
+		{
+			std::string s(70, 'a');
+			s.insert(at, 1, char(c));
+			same = encodeall(s) && same;
+			same = encodeall(s.substr(0, at + 1)) && same;
+		}
+		for (std::size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+			same = encodeall(std::string(lengths[i], char(c))) && same;
+	}
+	check(same, "every byte around block boundaries");
+
+	// Random bytes of random lengths.
+	same = true;
+	for (int n = 0; n < 20000; ++n)
+	{
+		std::string s(std::rand() % 200, '\0');
+		for (std::size_t i = 0; i < s.length(); ++i)
+			s[i] = std::rand() % 4 ? 'a' + std::rand() % 26 : std::rand();
+		same = encodeall(s) && same;
+	}
+	check(same, "random bytes");
+
+	std::cout << "variants run:";
+	for (int v = cgixx::codec_variant_scalar;
+		v <= cgixx::codec_variant_avx2; ++v)
+	{
+		if (!cgixx::cgi2textwith(cgixx::codecvariant(v), &c, 0, len))
+			std::cout << ' ' << names[v];
+	}
+	std::cout << std::endl;
+}
@@ -97,8 +97,40 @@ SOURCE=..\src\cookie.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\cookiescan.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\header.cxx
 # End Source File
+# Begin Source File
+
+SOURCE=..\src\httpdate.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\json.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\multipart.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\paramlist.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\response.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\siphash.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\urlcodec.cxx
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -117,11 +149,55 @@ SOURCE=..\inc\cgixx\cookie.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\cookiescan.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\inc\cgixx\form.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\inc\cgixx\header.h
 # End Source File
 # Begin Source File
 
-SOURCE=..\src\timedefs.inl
+SOURCE=..\src\httpdate.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\inc\cgixx\json.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\jsontape.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\multipart.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\paramlist.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\pmralloc.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\inc\cgixx\response.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\siphash.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\inc\cgixx\upload.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\urlcodec.h
 # End Source File
 # End Group
 # End Target